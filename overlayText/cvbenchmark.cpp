@@ -0,0 +1,501 @@
+#include "cvbenchmark.h"
+#include "cvcompositor.h"
+#include "cvoverlaylayer.h"
+#include "cvrendertext.h"
+#include "cvtextsprite.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(disable:4996)
+#endif
+
+static const wchar_t* kBenchText = L"Việt Nam sample text 0123456789 CAM-12 2026-10-17 13:45:07.120";
+static const size_t kBenchSize = 24;
+static const int kBenchLoops = 2000;
+
+// returns glyph lookups per second over all threads
+static double runCacheThreads(const char* path_to_font, int threads, bool shared) {
+	std::shared_ptr<CVGlyphCache> cache = std::make_shared<CVGlyphCache>();
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<int64> ticks(threads, 0);
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([&, t]() {
+			CVRenderText renderer(shared ? cache : std::shared_ptr<CVGlyphCache>());
+			renderer.setFont(path_to_font);
+			// warm the cache, only hits are measured
+			renderer.cacheGlyphs(kBenchText, kBenchSize, true, 2);
+
+			ready++;
+			while (!go.load())
+				std::this_thread::yield();
+
+			int64 start = cv::getTickCount();
+			for (int i = 0; i < kBenchLoops; i++)
+				renderer.cacheGlyphs(kBenchText, kBenchSize, true, 2);
+			ticks[t] = cv::getTickCount() - start;
+		}));
+	}
+
+	while (ready.load() < threads)
+		std::this_thread::yield();
+	go = true;
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	int64 slowest = 0;
+	for (int t = 0; t < threads; t++)
+		slowest = std::max(slowest, ticks[t]);
+
+	// fill and border glyph per character
+	double lookups = 2.0 * std::wcslen(kBenchText) * kBenchLoops * threads;
+	return lookups / (slowest / cv::getTickFrequency());
+}
+
+int benchGlyphCache(const char* path_to_font) {
+	CVRenderText probe;
+	if (probe.setFont(path_to_font) != 0) {
+		printf("cannot open font %s\n", path_to_font);
+		return -1;
+	}
+
+	printf("threads  private caches (Mlookup/s)  shared cache (Mlookup/s)\n");
+	for (int threads = 1; threads <= 64; threads *= 2) {
+		double priv = runCacheThreads(path_to_font, threads, false);
+		double shared = runCacheThreads(path_to_font, threads, true);
+		printf("%7d  %26.2f  %24.2f\n", threads, priv / 1e6, shared / 1e6);
+	}
+
+	return 0;
+}
+
+static const wchar_t* kHintingCharset = 
+	L" !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~"
+	L"ăâđêôơưĂÂĐÊÔƠƯáàảãạấầẩẫậéèẻẽẹếềểễệíìỉĩịóòỏõọốồổỗộớờởỡợúùủũụứừửữựýỳỷỹỵ";
+static const size_t kHintingSizes[] = { 12, 16, 24, 32, 48 };
+static const int kHintingLoops = 20;
+
+int benchHinting(const char* path_to_font) {
+	CVRenderText renderer;
+	if (renderer.setFont(path_to_font) != 0) {
+		printf("cannot open font %s\n", path_to_font);
+		return -1;
+	}
+
+	static const struct {
+		CVRenderText::Hinting hinting;
+		const char* name;
+	} presets[] = {
+		{ CVRenderText::FULL_HINTING, "FULL" },
+		{ CVRenderText::LIGHT_HINTING, "LIGHT" },
+		{ CVRenderText::FAST_HINTING, "FAST" }
+	};
+	const int sizeCount = sizeof(kHintingSizes) / sizeof(kHintingSizes[0]);
+
+	printf("preset  rasterize (us/glyph)  glyphs  footprint (KB)\n");
+	for (int p = 0; p < 3; p++) {
+		renderer.setHinting(presets[p].hinting);
+
+		std::shared_ptr<CVGlyphCache> cache;
+		int64 ticks = 0;
+		for (int i = 0; i < kHintingLoops; i++) {
+			// every loop starts cold, so each lookup rasterizes
+			cache = std::make_shared<CVGlyphCache>();
+			renderer.setGlyphCache(cache);
+
+			int64 start = cv::getTickCount();
+			for (int s = 0; s < sizeCount; s++)
+				renderer.cacheGlyphs(kHintingCharset, kHintingSizes[s], true, 2);
+			ticks += cv::getTickCount() - start;
+		}
+
+		size_t glyphs = 0;
+		size_t bytes = cache->footprint(presets[p].hinting, &glyphs);
+		double usPerGlyph = glyphs ? ticks / cv::getTickFrequency() * 1e6 / ((double)glyphs * kHintingLoops) : 0.0;
+		printf("%-6s  %20.2f  %6d  %14.1f\n", presets[p].name, usPerGlyph, (int)glyphs, bytes / 1024.0);
+	}
+
+	return 0;
+}
+
+static const int kCheckSize = 64;
+// 16-bit kernels round each stage to 16 bits instead of 8
+static const int kDepthTolerance = 1;
+static const int kLegacyRounds = 16;
+
+static void randomize(cv::RNG& rng, cv::Mat& m) {
+	for (int y = 0; y < m.rows; y++) {
+		uchar* p = m.ptr<uchar>(y);
+		for (size_t i = 0; i < m.cols * m.elemSize(); i++)
+			p[i] = (uchar)rng;
+	}
+}
+
+// destination of the given depth and channels holding the pixels of src
+// (CV_8UC3): gray takes channel 0, alpha gets a pattern that must survive
+static void makeDestination(const cv::Mat& src, int depth, int cn, cv::Mat& dst) {
+	dst.create(src.rows, src.cols, CV_MAKETYPE(depth, cn));
+	for (int y = 0; y < src.rows; y++) {
+		const uchar* s = src.ptr<uchar>(y);
+		for (int x = 0; x < src.cols; x++) {
+			for (int ch = 0; ch < cn; ch++) {
+				int v = ch < 3 ? s[3 * x + ch] : (x * 7 + y) & 255;
+				if (depth == CV_16U)
+					dst.ptr<ushort>(y)[x * cn + ch] = (ushort)(v * 257);
+				else
+					dst.ptr<uchar>(y)[x * cn + ch] = (uchar)v;
+			}
+		}
+	}
+}
+
+// largest difference to ref in 8-bit steps, -1 when the alpha was touched
+static int compareDestination(const cv::Mat& ref, const cv::Mat& dst) {
+	int depth = dst.depth();
+	int cn = dst.channels();
+	int worst = 0;
+	for (int y = 0; y < ref.rows; y++) {
+		const uchar* r = ref.ptr<uchar>(y);
+		for (int x = 0; x < ref.cols; x++) {
+			for (int ch = 0; ch < cn; ch++) {
+				int v = depth == CV_16U ? (dst.ptr<ushort>(y)[x * cn + ch] + 128) / 257 : dst.ptr<uchar>(y)[x * cn + ch];
+				if (ch == 3) {
+					if (v != ((x * 7 + y) & 255))
+						return -1;
+					continue;
+				}
+				worst = std::max(worst, std::abs(v - r[3 * x + ch]));
+			}
+		}
+	}
+	return worst;
+}
+
+// cv::multiply(coeffMat, img, img, 1.0/255.0) of the old renderText, with
+// coeffMat the coverage merged into three channels; merge gives it the
+// coverage's 8-bit type, so each product is a saturate_cast of the float
+// product back to 8 bits
+static void legacyMultiply(const cv::Mat& coverage, cv::Mat& img) {
+	std::vector<cv::Mat> coeff(3, coverage);
+	cv::Mat coeffMat;
+	cv::merge(coeff, coeffMat);
+	cv::multiply(coeffMat, img, img, 1.0/255.0);
+}
+
+// The blend of renderText before the series, on its mats and stage for
+// stage: gray_outline is the outline coverage (the text's without border),
+// gray_text the text coverage, blendImg the destination.
+static void legacyBlend(const CVTextStyle& style, const cv::Mat& gray_outline, const cv::Mat& gray_text, cv::Mat& blendImg) {
+	cv::Mat gray_bgr(gray_outline.size(), CV_8UC1, cv::Scalar::all(255));
+	cv::Mat gray_img(gray_outline.size(), CV_8UC1, cv::Scalar::all(255));
+	cv::Mat outline_clr(gray_outline.size(), CV_8UC3, style.brdColor());
+	cv::Mat text_clr(gray_text.size(), CV_8UC3, style.textColor());
+	cv::Mat bgrd_clr(gray_outline.size(), CV_8UC3, style.bgrColor());
+
+	cv::subtract(gray_bgr, gray_outline, gray_bgr);
+	cv::subtract(gray_img, gray_outline, gray_img);
+
+	if (style.hasBorder()) {
+		legacyMultiply(gray_outline, outline_clr);
+		legacyMultiply(gray_text, text_clr);
+	} else {
+		legacyMultiply(gray_outline, text_clr);
+	}
+
+	// opacity() is the 0.9375*x + 0.0625 renderText worked out
+	if (style.hasBackgrnd()) {
+		gray_img *= (1.0 - style.opacity());
+		gray_bgr *= style.opacity();
+		legacyMultiply(gray_bgr, bgrd_clr);
+	}
+
+	legacyMultiply(style.hasBackgrnd() ? gray_img : gray_bgr, blendImg);
+	if (style.hasBorder()) {
+		cv::add(blendImg, outline_clr, blendImg);
+		gray_img = cv::Mat(gray_text.size(), CV_8UC1, cv::Scalar::all(255));
+		cv::subtract(gray_img, gray_text, gray_img);
+		legacyMultiply(gray_img, blendImg);
+		cv::add(blendImg, text_clr, blendImg);
+	} else {
+		cv::add(blendImg, text_clr, blendImg);
+	}
+
+	if (style.hasBackgrnd())
+		cv::add(blendImg, bgrd_clr, blendImg);
+}
+
+// every outline and text coverage pair through the old renderText blend,
+// over random destinations, against the 8-bit and 16-bit kernels, a sprite
+// and an overlay layer holding that sprite
+static int checkLegacyBlend(cv::RNG& rng) {
+	static const struct {
+		cv::Scalar textColor;
+		bool hasBorder;
+		cv::Scalar brdColor;
+		bool hasBackgrnd;
+		cv::Scalar bgrColor;
+		double bgrOpacity;
+	} styles[] = {
+		{ cv::Scalar::all(37), true, cv::Scalar::all(200), true, cv::Scalar::all(200), 0.4 },
+		{ cv::Scalar::all(37), true, cv::Scalar::all(37), false, cv::Scalar::all(0), 0.0 },
+		{ cv::Scalar(37, 200, 90), false, cv::Scalar::all(0), true, cv::Scalar(200, 120, 30), 0.4 },
+		{ cv::Scalar(0, 255, 255), true, cv::Scalar::all(0), true, cv::Scalar(128, 128, 0), 0.1 },
+		{ cv::Scalar::all(255), true, cv::Scalar::all(0), false, cv::Scalar::all(0), 0.0 }
+	};
+	const int styleCount = sizeof(styles) / sizeof(styles[0]);
+
+	cv::Mat outline(256, 256, CV_8UC1);
+	cv::Mat fill(256, 256, CV_8UC1);
+	for (int y = 0; y < 256; y++) {
+		for (int x = 0; x < 256; x++) {
+			outline.at<uchar>(y, x) = (uchar)y;
+			fill.at<uchar>(y, x) = (uchar)x;
+		}
+	}
+	cv::Mat src(256, 256, CV_8UC3);
+	cv::Mat ref, dst;
+	int failures = 0;
+
+	printf("style  border  background  8U diff  16U diff  sprite diff  layer diff\n");
+	for (int i = 0; i < styleCount; i++) {
+		CVTextStyle style(24, styles[i].textColor, styles[i].hasBorder, 2, styles[i].brdColor, 
+			styles[i].hasBackgrnd, styles[i].bgrColor, styles[i].bgrOpacity);
+		CVTextSprite sprite;
+		sprite.compose(outline, fill, style);
+		CVOverlayLayer layer(src.size());
+		layer.add(sprite, cv::Point(0, 0), CVRenderText::LEFT_MARGIN, CVRenderText::TOP_MARGIN);
+
+		// worst difference of 8U, 16U, sprite and layer, -1 for a touched alpha
+		int worst[4] = { 0, 0, 0, 0 };
+		for (int round = 0; round < kLegacyRounds; round++) {
+			randomize(rng, src);
+			src.copyTo(ref);
+			legacyBlend(style, style.hasBorder() ? outline : fill, fill, ref);
+
+			int diff[4];
+			makeDestination(src, CV_8U, 3, dst);
+			cvBlendCoverage(style, outline, fill, dst);
+			diff[0] = compareDestination(ref, dst);
+			makeDestination(src, CV_16U, 4, dst);
+			cvBlendCoverage(style, outline, fill, dst);
+			diff[1] = compareDestination(ref, dst);
+			src.copyTo(dst);
+			sprite.draw(dst, cv::Point(0, 0), CVRenderText::LEFT_MARGIN, CVRenderText::TOP_MARGIN);
+			diff[2] = compareDestination(ref, dst);
+			src.copyTo(dst);
+			layer.apply(dst);
+			diff[3] = compareDestination(ref, dst);
+
+			for (int k = 0; k < 4; k++)
+				worst[k] = worst[k] < 0 || diff[k] < 0 ? -1 : std::max(worst[k], diff[k]);
+		}
+
+		bool ok = worst[0] == 0 && worst[1] >= 0 && worst[1] <= kDepthTolerance && worst[2] == 0 && worst[3] == 0;
+		if (!ok)
+			failures++;
+		printf("%5d  %6d  %10d  %7d  %8d  %11d  %10d%s\n", i, (int)styles[i].hasBorder, (int)styles[i].hasBackgrnd, 
+			worst[0], worst[1], worst[2], worst[3], ok ? "" : "  MISMATCH");
+	}
+	printf("\n");
+
+	return failures;
+}
+
+int checkBlendKernels() {
+	cv::RNG rng(0x5eed);
+	cv::Mat outline(kCheckSize, kCheckSize, CV_8UC1);
+	cv::Mat fill(kCheckSize, kCheckSize, CV_8UC1);
+	cv::Mat shadow(kCheckSize, kCheckSize, CV_8UC1);
+	cv::Mat glow(kCheckSize, kCheckSize, CV_8UC1);
+	cv::Mat src(kCheckSize, kCheckSize, CV_8UC3);
+	cv::Mat ref;
+	cv::Mat dst;
+
+	static const int depths[] = { CV_8U, CV_16U };
+	static const int channels[] = { 1, 3, 4 };
+	int failures = checkLegacyBlend(rng);
+
+	printf("depth  channels  border  background  shadow  glow  max diff\n");
+	for (int variant = 0; variant < 16; variant++) {
+		bool border = (variant & 8) != 0;
+		bool background = (variant & 4) != 0;
+		bool hasShadow = (variant & 2) != 0;
+		bool hasGlow = (variant & 1) != 0;
+
+		CVTextStyle style(24, cv::Scalar(37, 200, 90), border, 2, cv::Scalar(200, 20, 140), background, cv::Scalar(200, 120, 30), 0.4);
+		if (hasShadow)
+			style.setShadow(cv::Point(2, 2), 2, cv::Scalar(10, 20, 30), 0.6);
+		if (hasGlow)
+			style.setGlow(3, cv::Scalar(250, 240, 230), 0.8);
+
+		randomize(rng, outline);
+		randomize(rng, fill);
+		randomize(rng, shadow);
+		randomize(rng, glow);
+		randomize(rng, src);
+		cv::Mat s = hasShadow ? shadow : cv::Mat();
+		cv::Mat g = hasGlow ? glow : cv::Mat();
+
+		makeDestination(src, CV_8U, 3, ref);
+		cvBlendCoverageReference(style, outline, fill, ref, s, g);
+
+		for (int d = 0; d < 2; d++) {
+			for (int c = 0; c < 3; c++) {
+				makeDestination(src, depths[d], channels[c], dst);
+				cvBlendCoverage(style, outline, fill, dst, s, g);
+
+				int diff = compareDestination(ref, dst);
+				bool ok = diff >= 0 && diff <= (depths[d] == CV_16U ? kDepthTolerance : 0);
+				if (!ok)
+					failures++;
+				printf("%5s  %8d  %6d  %10d  %6d  %4d  %8d%s\n", depths[d] == CV_16U ? "16U" : "8U", channels[c], 
+					(int)border, (int)background, (int)hasShadow, (int)hasGlow, diff, ok ? "" : "  MISMATCH");
+			}
+		}
+	}
+
+	return failures ? -1 : 0;
+}
+
+static const int kCheckReaders = 300;
+static const int kCheckLoops = 2000;
+static const uint32_t kCheckGlyphs = 4096;
+static const size_t kCheckCapacity = 64;
+
+static const CVGlyph* findOrInsert(CVGlyphCache& cache, uint32_t glyph) {
+	CVGlyphKey key(1, 16, glyph, 0);
+	const CVGlyph* found = cache.find(key);
+	if (found)
+		return found;
+
+	CVGlyph entry;
+	entry.advance = (int)glyph;
+	return cache.insert(key, entry);
+}
+
+// inserts count glyphs from first on, evicting as many, under its own guard
+static void churn(CVGlyphCache& cache, int readerId, uint32_t first, uint32_t count) {
+	CVGlyphCache::ReadGuard guard(cache, readerId);
+	for (uint32_t g = first; g < first + count; g++)
+		findOrInsert(cache, g);
+}
+
+int checkGlyphCacheReaders() {
+	int failures = 0;
+
+	// an inner guard must not unpin the outer one
+	{
+		CVGlyphCache cache(kCheckCapacity);
+		int reader = cache.registerReader();
+		int writer = cache.registerReader();
+		churn(cache, writer, 0, kCheckCapacity);
+
+		size_t pinned;
+		{
+			CVGlyphCache::ReadGuard outer(cache, reader);
+			{
+				CVGlyphCache::ReadGuard inner(cache, reader);
+			}
+			churn(cache, writer, kCheckCapacity, 4 * kCheckCapacity);
+			pinned = cache.retired();
+		}
+		churn(cache, writer, 5 * kCheckCapacity, 1);
+		size_t released = cache.retired();
+
+		bool ok = pinned >= 4 * kCheckCapacity && released < kCheckCapacity;
+		if (!ok)
+			failures++;
+		printf("nested guard: %d retired while pinned, %d after%s\n", (int)pinned, (int)released, ok ? "" : "  FAILED");
+	}
+
+	// anonymous guards that always overlap, each opened before the last closes
+	{
+		CVGlyphCache cache(kCheckCapacity);
+		std::vector<int> ids;
+		for (int i = 0; i < kCheckReaders; i++)
+			ids.push_back(cache.registerReader());
+		int writer = ids[0];
+
+		std::unique_ptr<CVGlyphCache::ReadGuard> last(new CVGlyphCache::ReadGuard(cache, -1));
+		uint32_t next = 0;
+		for (int round = 0; round < 16; round++) {
+			std::unique_ptr<CVGlyphCache::ReadGuard> guard(new CVGlyphCache::ReadGuard(cache, -1));
+			last = std::move(guard);
+			churn(cache, writer, next, 2 * kCheckCapacity);
+			next += 2 * kCheckCapacity;
+		}
+		size_t pending = cache.retired();
+		last.reset();
+
+		bool ok = ids.back() == -1 && pending < 8 * kCheckCapacity;
+		if (!ok)
+			failures++;
+		printf("overlapping anonymous guards: %d of %d retired entries unfreed%s\n", (int)pending, (int)next, ok ? "" : "  FAILED");
+		for (size_t i = 0; i < ids.size(); i++)
+			cache.unregisterReader(ids[i]);
+	}
+
+	// kCheckReaders threads, the last of them without a reader id
+	{
+		CVGlyphCache cache(kCheckCapacity);
+		std::atomic<int> ready(0);
+		std::atomic<bool> go(false);
+		std::atomic<int> running(kCheckReaders);
+		std::atomic<int> anonymous(0);
+		std::atomic<int> misses(0);
+		std::atomic<int> wrong(0);
+		std::vector<std::thread> workers;
+
+		for (int t = 0; t < kCheckReaders; t++) {
+			workers.push_back(std::thread([&, t]() {
+				int id = cache.registerReader();
+				if (id < 0)
+					anonymous++;
+				ready++;
+				while (!go.load())
+					std::this_thread::yield();
+
+				cv::RNG rng(t + 1);
+				for (int i = 0; i < kCheckLoops; i++) {
+					CVGlyphCache::ReadGuard guard(cache, id);
+					uint32_t glyph = rng.uniform(0, (int)kCheckGlyphs);
+					const CVGlyph* found = cache.find(CVGlyphKey(1, 16, glyph, 0));
+					if (!found) {
+						misses++;
+						found = findOrInsert(cache, glyph);
+					}
+					if (found->advance != (int)glyph)
+						wrong++;
+				}
+				cache.unregisterReader(id);
+				running--;
+			}));
+		}
+
+		while (ready.load() < kCheckReaders)
+			std::this_thread::yield();
+		go = true;
+
+		size_t worst = 0;
+		while (running.load() > 0) {
+			worst = std::max(worst, cache.retired());
+			std::this_thread::yield();
+		}
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+
+		bool ok = anonymous.load() > 0 && wrong.load() == 0 && worst * 4 < (size_t)misses.load();
+		if (!ok)
+			failures++;
+		printf("%d threads (%d without id): at most %d of %d retired entries unfreed%s\n", kCheckReaders, anonymous.load(), 
+			(int)worst, misses.load(), ok ? "" : "  FAILED");
+	}
+
+	return failures ? -1 : 0;
+}
@@ -0,0 +1,27 @@
+#ifndef CV_BENCHMARK_H__
+#define CV_BENCHMARK_H__
+
+// Glyph cache contention: 1..64 render threads, each renderer with its own
+// private cache versus all of them sharing one cache.
+int benchGlyphCache(const char* path_to_font);
+
+// Rasterization cost and glyph cache footprint of each hinting preset,
+// from a cold cache.
+int benchHinting(const char* path_to_font);
+
+// Checks the blends against the float mat blend renderText used to run,
+// written out stage for stage, over every coverage pair: the 8-bit kernels,
+// a sprite and an overlay layer have to give the same bytes, the 16-bit
+// kernels to be within one 8-bit step. Then runs every specialised
+// cvBlendCoverage kernel on random coverage against
+// cvBlendCoverageReference, with the same tolerances. Returns -1 on a
+// mismatch.
+int checkBlendKernels();
+
+// Glyph cache reclamation with more readers than reader ids: nested guards
+// keep the outer epoch, overlapping anonymous guards do not hold retired
+// entries forever, and under 300 threads the unfreed entries stay a small
+// part of those retired. Returns -1 on a failure.
+int checkGlyphCacheReaders();
+
+#endif//CV_BENCHMARK_H__
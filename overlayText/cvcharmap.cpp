@@ -0,0 +1,100 @@
+#include "cvcharmap.h"
+
+const uint32_t CVCharMap::UNKNOWN;
+
+static inline size_t hashCodepoint(uint32_t codepoint) {
+	// Fibonacci hashing, CJK code points are dense
+	return (size_t)(codepoint * 2654435761u);
+}
+
+CVCharMap::CVCharMap()
+	: mFace(NULL)
+	, mComplete(false)
+	, mCount(0) {
+	reset(NULL);
+}
+
+void CVCharMap::reset(FT_Face face) {
+	mFace = face;
+	mComplete = false;
+	mDirect.assign(DIRECT_SIZE, UNKNOWN);
+	mKeys.assign(256, UNKNOWN);
+	mValues.assign(256, 0);
+	mCount = 0;
+}
+
+FT_UInt CVCharMap::lookupSlow(uint32_t codepoint) {
+	if (codepoint >= DIRECT_SIZE) {
+		size_t mask = mKeys.size() - 1;
+		for (size_t i = hashCodepoint(codepoint) & mask; ; i = (i + 1) & mask) {
+			if (mKeys[i] == codepoint)
+				return mValues[i];
+			if (mKeys[i] == UNKNOWN)
+				break;
+		}
+	}
+
+	// after a bulk load anything missing is unmapped
+	if (mComplete || !mFace)
+		return 0;
+
+	FT_UInt glyph_index = FT_Get_Char_Index(mFace, codepoint);
+	insert(codepoint, glyph_index);
+	return glyph_index;
+}
+
+void CVCharMap::insert(uint32_t codepoint, FT_UInt glyph_index) {
+	if (codepoint < DIRECT_SIZE) {
+		mDirect[codepoint] = glyph_index;
+		return;
+	}
+
+	if ((mCount + 1) * 2 > mKeys.size())
+		grow();
+
+	size_t mask = mKeys.size() - 1;
+	for (size_t i = hashCodepoint(codepoint) & mask; ; i = (i + 1) & mask) {
+		if (mKeys[i] == UNKNOWN) {
+			mKeys[i] = codepoint;
+			mValues[i] = glyph_index;
+			mCount++;
+			return;
+		}
+		if (mKeys[i] == codepoint) {
+			mValues[i] = glyph_index;
+			return;
+		}
+	}
+}
+
+void CVCharMap::grow() {
+	std::vector<uint32_t> keys(mKeys.size() * 2, UNKNOWN);
+	std::vector<uint32_t> values(mValues.size() * 2, 0);
+	keys.swap(mKeys);
+	values.swap(mValues);
+	mCount = 0;
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		if (keys[i] != UNKNOWN)
+			insert(keys[i], values[i]);
+	}
+}
+
+void CVCharMap::load() {
+	if (!mFace)
+		return;
+
+	FT_UInt glyph_index;
+	FT_ULong codepoint = FT_Get_First_Char(mFace, &glyph_index);
+	while (glyph_index != 0) {
+		insert((uint32_t)codepoint, glyph_index);
+		codepoint = FT_Get_Next_Char(mFace, codepoint, &glyph_index);
+	}
+
+	// unmapped code points of the direct range resolve to .notdef
+	for (size_t i = 0; i < DIRECT_SIZE; i++) {
+		if (mDirect[i] == UNKNOWN)
+			mDirect[i] = 0;
+	}
+	mComplete = true;
+}
@@ -0,0 +1,52 @@
+#ifndef CV_CHAR_MAP_H__
+#define CV_CHAR_MAP_H__
+
+#include <stdint.h>
+#include <vector>
+
+// FreeType headers
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+// Code point to glyph index cache of one face, so that mapping a character
+// does not walk the cmap subtable every time. Code points below DIRECT_SIZE
+// (Latin, Vietnamese, Greek, Cyrillic, ...) index an array directly; the
+// rest, CJK mostly, go to a small open-addressing table. Entries are filled
+// lazily from FT_Get_Char_Index, or all at once by load().
+class CVCharMap
+{
+protected:
+	enum { DIRECT_SIZE = 0x2000 };
+	static const uint32_t UNKNOWN = 0xFFFFFFFF;
+
+	FT_Face mFace;
+	bool mComplete;		// every mapped code point is in the tables
+	std::vector<uint32_t> mDirect;
+	std::vector<uint32_t> mKeys;		// UNKNOWN marks an empty slot
+	std::vector<uint32_t> mValues;
+	size_t mCount;
+
+	FT_UInt lookupSlow(uint32_t codepoint);
+	void insert(uint32_t codepoint, FT_UInt glyph_index);
+	void grow();
+
+public:
+	CVCharMap();
+
+	// start over for a new face (NULL to detach)
+	void reset(FT_Face face);
+
+	// bulk load every mapping of the face's charmap
+	void load();
+
+	FT_UInt glyphIndex(uint32_t codepoint) {
+		if (codepoint < DIRECT_SIZE) {
+			uint32_t glyph_index = mDirect[codepoint];
+			if (glyph_index != UNKNOWN)
+				return glyph_index;
+		}
+		return lookupSlow(codepoint);
+	}
+};
+
+#endif//CV_CHAR_MAP_H__
@@ -0,0 +1,565 @@
+#include "cvcompositor.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+static const uint32_t kHalf = CVTextStyle::ONE / 2;
+
+static inline uchar fromQ(uint32_t v) {
+	v = (v + kHalf) >> CVTextStyle::FRACTION_BITS;
+	return (uchar)(v > 255 ? 255 : v);
+}
+
+static void boxBlur(const cv::Mat& src, cv::Mat& dst, int radius) {
+	// separable running sums, vectorized by OpenCV
+	if (radius > 0)
+		cv::blur(src, dst, cv::Size(2 * radius + 1, 2 * radius + 1), cv::Point(-1, -1), cv::BORDER_CONSTANT);
+	else
+		src.copyTo(dst);
+}
+
+cv::Point cvEffectCoverage(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, CVEffectBuffers& effects) {
+	if (!style.hasEffects()) {
+		effects.outline = outline;
+		effects.fill = fill;
+		effects.shadow.release();
+		effects.glow.release();
+		return cv::Point(0, 0);
+	}
+
+	int left, top, right, bottom;
+	style.effectPadding(left, top, right, bottom);
+
+	// the padded planes are written in place, unless they still refer to
+	// the coverage from a call without effects
+	if (effects.outline.data == outline.data)
+		effects.outline.release();
+	if (effects.fill.data == fill.data)
+		effects.fill.release();
+	cv::copyMakeBorder(outline, effects.outline, top, bottom, left, right, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+	cv::copyMakeBorder(fill, effects.fill, top, bottom, left, right, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+
+	// effects follow the outer edge of the label
+	const cv::Mat& outer = style.hasBorder() ? effects.outline : effects.fill;
+
+	if (style.hasShadow()) {
+		cv::Point offset = style.shadowOffset();
+		effects.moved.create(outer.size(), CV_8UC1);
+		effects.moved.setTo(cv::Scalar::all(0));
+		cv::Rect src = cv::Rect(0, 0, outer.cols, outer.rows) & cv::Rect(-offset.x, -offset.y, outer.cols, outer.rows);
+		if (src.area() > 0)
+			outer(src).copyTo(effects.moved(src + offset));
+		boxBlur(effects.moved, effects.shadow, style.shadowBlur());
+	} else {
+		effects.shadow.release();
+	}
+
+	if (style.hasGlow()) {
+		// the box halves the coverage at the edge, bring it back up
+		boxBlur(outer, effects.glow, style.glowRadius());
+		effects.glow.convertTo(effects.glow, CV_8U, 2.0);
+	} else {
+		effects.glow.release();
+	}
+
+	return cv::Point(left, top);
+}
+
+void cvBlendCoverageReference(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst, const cv::Mat& shadow, const cv::Mat& glow) {
+	CV_Assert(dst.type() == CV_8UC3 && outline.size() == dst.size() && fill.size() == dst.size());
+	CV_Assert((shadow.empty() || shadow.size() == dst.size()) && (glow.empty() || glow.size() == dst.size()));
+
+	const uchar* imageKeep = style.imageKeep();
+	const CVTextStyle::Color8* outerColor = style.outerColor8();
+	const CVTextStyle::Color8* innerColor = style.innerColor8();
+	const CVTextStyle::Color8* background = style.background8();
+	const uint32_t* shadowKeep = style.shadowKeep();
+	const CVTextStyle::ColorQ* shadowColor = style.shadowColorQ();
+	const uint32_t* glowKeep = style.glowKeep();
+	const CVTextStyle::ColorQ* glowColor = style.glowColorQ();
+	bool hasBorder = style.hasBorder();
+	bool hasBackgrnd = style.hasBackgrnd();
+
+	for (int y = 0; y < dst.rows; y++) {
+		const uchar* o = (hasBorder ? outline : fill).ptr<uchar>(y);
+		const uchar* t = fill.ptr<uchar>(y);
+		const uchar* s = shadow.empty() ? NULL : shadow.ptr<uchar>(y);
+		const uchar* g = glow.empty() ? NULL : glow.ptr<uchar>(y);
+		uchar* d = dst.ptr<uchar>(y);
+
+		for (int x = 0; x < dst.cols; x++, d += 3) {
+			for (int ch = 0; ch < 3; ch++) {
+				uint32_t dd = d[ch];
+				// effect layers under the label, in the same pass
+				if (g)
+					dd = fromQ(dd * glowKeep[g[x]] + glowColor[g[x]][ch]);
+				if (s)
+					dd = fromQ(dd * shadowKeep[s[x]] + shadowColor[s[x]][ch]);
+
+				// border (or text) over the destination
+				uint32_t v = std::min(CVTextStyle::div255(imageKeep[o[x]] * dd) + outerColor[o[x]][ch], 255u);
+				// text over the border
+				if (hasBorder)
+					v = std::min(CVTextStyle::div255((255 - t[x]) * v) + innerColor[t[x]][ch], 255u);
+				if (hasBackgrnd)
+					v = std::min(v + background[o[x]][ch], 255u);
+				d[ch] = (uchar)v;
+			}
+		}
+	}
+}
+
+// the style's label tables, fetched once per blend
+struct LabelTables {
+	const uchar* imageKeep;
+	const CVTextStyle::Color8* outerColor8;
+	const CVTextStyle::Color8* innerColor8;
+	const CVTextStyle::Color8* background8;
+
+	explicit LabelTables(const CVTextStyle& style)
+		: imageKeep(style.imageKeep())
+		, outerColor8(style.outerColor8())
+		, innerColor8(style.innerColor8())
+		, background8(style.background8()) {}
+};
+
+// Arithmetic of one destination depth. Effect colours are Q15 per 8-bit
+// value and get scaled to the depth's range.
+template<typename T> struct BlendPixel;
+
+template<> struct BlendPixel<uchar> {
+	typedef uint32_t acc_t;
+	enum { SCALE = 1 };
+	static uchar fromQ(acc_t v) { return ::fromQ(v); }
+
+	// the 8-bit stages of the float blend
+	template<bool BORDER, bool BACKGROUND>
+	static uchar label(const LabelTables& lt, acc_t d, int o, int t, int ch) {
+		acc_t v = std::min(CVTextStyle::div255(lt.imageKeep[o] * d) + lt.outerColor8[o][ch], 255u);
+		if (BORDER)
+			v = std::min(CVTextStyle::div255((255 - t) * v) + lt.innerColor8[t][ch], 255u);
+		if (BACKGROUND)
+			v = std::min(v + lt.background8[o][ch], 255u);
+		return (uchar)v;
+	}
+};
+
+template<> struct BlendPixel<ushort> {
+	typedef uint64_t acc_t;
+	enum { SCALE = 257 };
+	static ushort fromQ(acc_t v) {
+		v = (v + kHalf) >> CVTextStyle::FRACTION_BITS;
+		return (ushort)(v > 65535 ? 65535 : v);
+	}
+
+	// round(x / 255) for x up to 65535 * 255
+	static uint32_t div255(uint32_t x) { return (x + 127) / 255; }
+
+	// the same stages, each rounded to 16 bits instead of 8
+	template<bool BORDER, bool BACKGROUND>
+	static ushort label(const LabelTables& lt, acc_t d, int o, int t, int ch) {
+		uint32_t v = std::min(div255(lt.imageKeep[o] * (uint32_t)d) + lt.outerColor8[o][ch] * SCALE, 65535u);
+		if (BORDER)
+			v = std::min(div255((255 - t) * v) + lt.innerColor8[t][ch] * SCALE, 65535u);
+		if (BACKGROUND)
+			v = std::min(v + lt.background8[o][ch] * SCALE, 65535u);
+		return (ushort)v;
+	}
+};
+
+// cvBlendCoverageReference specialised at compile time: every option is a
+// template argument, so the inner loop has no branches on the style or on
+// which effect layers there are. Gray destinations take channel 0 (blue)
+// of the colours; a fourth channel is kept.
+template<typename T, int CN, bool BORDER, bool BACKGROUND, bool SHADOW, bool GLOW>
+static void blendKernel(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst, const cv::Mat& shadow, const cv::Mat& glow) {
+	typedef BlendPixel<T> P;
+	typedef typename P::acc_t acc_t;
+	const int channels = CN < 3 ? CN : 3;
+	const acc_t scale = P::SCALE;
+
+	const LabelTables lt(style);
+	const uint32_t* shadowKeep = style.shadowKeep();
+	const CVTextStyle::ColorQ* shadowColor = style.shadowColorQ();
+	const uint32_t* glowKeep = style.glowKeep();
+	const CVTextStyle::ColorQ* glowColor = style.glowColorQ();
+
+	for (int y = 0; y < dst.rows; y++) {
+		const uchar* o = (BORDER ? outline : fill).ptr<uchar>(y);
+		const uchar* t = fill.ptr<uchar>(y);
+		const uchar* s = SHADOW ? shadow.ptr<uchar>(y) : NULL;
+		const uchar* g = GLOW ? glow.ptr<uchar>(y) : NULL;
+		T* d = dst.ptr<T>(y);
+
+		for (int x = 0; x < dst.cols; x++, d += CN) {
+			for (int ch = 0; ch < channels; ch++) {
+				acc_t dd = d[ch];
+				if (GLOW)
+					dd = P::fromQ(dd * glowKeep[g[x]] + glowColor[g[x]][ch] * scale);
+				if (SHADOW)
+					dd = P::fromQ(dd * shadowKeep[s[x]] + shadowColor[s[x]][ch] * scale);
+
+				d[ch] = P::template label<BORDER, BACKGROUND>(lt, dd, o[x], t[x], ch);
+			}
+		}
+	}
+}
+
+typedef void (*BlendKernel)(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst, const cv::Mat& shadow, const cv::Mat& glow);
+
+// [shadow][glow] for one pixel type and label
+#define CV_EFFECT_KERNELS(T, CN, BORDER, BACKGROUND) { \
+	{ blendKernel<T, CN, BORDER, BACKGROUND, false, false>, blendKernel<T, CN, BORDER, BACKGROUND, false, true> }, \
+	{ blendKernel<T, CN, BORDER, BACKGROUND, true, false>, blendKernel<T, CN, BORDER, BACKGROUND, true, true> } }
+
+// [border][background][shadow][glow] for one pixel type
+#define CV_BLEND_KERNELS(T, CN) { \
+	{ CV_EFFECT_KERNELS(T, CN, false, false), CV_EFFECT_KERNELS(T, CN, false, true) }, \
+	{ CV_EFFECT_KERNELS(T, CN, true, false), CV_EFFECT_KERNELS(T, CN, true, true) } }
+
+// [depth: 8U, 16U][channels: 1, 3, 4][border][background][shadow][glow]
+static const BlendKernel kBlendKernels[2][3][2][2][2][2] = {
+	{ CV_BLEND_KERNELS(uchar, 1), CV_BLEND_KERNELS(uchar, 3), CV_BLEND_KERNELS(uchar, 4) },
+	{ CV_BLEND_KERNELS(ushort, 1), CV_BLEND_KERNELS(ushort, 3), CV_BLEND_KERNELS(ushort, 4) }
+};
+
+#undef CV_BLEND_KERNELS
+#undef CV_EFFECT_KERNELS
+
+void cvBlendCoverage(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst, const cv::Mat& shadow, const cv::Mat& glow) {
+	int depth = dst.depth();
+	int cn = dst.channels();
+	CV_Assert((depth == CV_8U || depth == CV_16U) && (cn == 1 || cn == 3 || cn == 4));
+	CV_Assert(outline.size() == dst.size() && fill.size() == dst.size());
+	CV_Assert((shadow.empty() || shadow.size() == dst.size()) && (glow.empty() || glow.size() == dst.size()));
+
+	BlendKernel kernel = kBlendKernels[depth == CV_16U][cn == 1 ? 0 : cn == 3 ? 1 : 2][style.hasBorder()][style.hasBackgrnd()]
+		[!shadow.empty()][!glow.empty()];
+	kernel(style, outline, fill, dst, shadow, glow);
+}
+
+// One row of the sprite composition, in the stages of the 8-bit blend: the
+// border (or text) over the destination with the effect layers folded
+// under it, then the text over the border, the background added to the
+// last one. The second stage goes to innerColor/innerK, or is folded into
+// the first one when they are NULL. color has colorStep bytes per pixel and
+// may be NULL; k gets the transmission, or the alpha (255 - k) with alpha
+// set, every kStep bytes. s and g are the effect rows, read only with
+// SHADOW and GLOW.
+template<bool SHADOW, bool GLOW>
+static void composeRow(const CVTextStyle& style, const uchar* o, const uchar* t, const uchar* s, const uchar* g, int n, 
+		uchar* color, int colorStep, uchar* k, int kStep, bool alpha, uchar* innerColor, uchar* innerK) {
+	const uchar* imageKeep = style.imageKeep();
+	const CVTextStyle::Color8* outerColor = style.outerColor8();
+	const CVTextStyle::Color8* textColor = style.innerColor8();
+	const CVTextStyle::Color8* background = style.background8();
+	const uint32_t* shadowKeep = style.shadowKeep();
+	const CVTextStyle::ColorQ* shadowColor = style.shadowColorQ();
+	const uint32_t* glowKeep = style.glowKeep();
+	const CVTextStyle::ColorQ* glowColor = style.glowColorQ();
+	bool hasBorder = style.hasBorder();
+
+	for (int x = 0; x < n; x++, k += kStep) {
+		unsigned int k1 = imageKeep[o[x]];
+		unsigned int c1[3];
+		unsigned int k2 = hasBorder ? 255 - t[x] : 255;
+		unsigned int c2[3] = { 0, 0, 0 };
+		for (int ch = 0; ch < 3; ch++) {
+			c1[ch] = outerColor[o[x]][ch];
+			if (hasBorder) {
+				c2[ch] = std::min((unsigned int)textColor[t[x]][ch] + background[o[x]][ch], 255u);
+			} else {
+				c1[ch] = std::min(c1[ch] + background[o[x]][ch], 255u);
+			}
+		}
+
+		// effect layers: transmission ke (Q15) and colour ce (Q15 per 8-bit
+		// value), glow first, then shadow over it
+		if (SHADOW || GLOW) {
+			uint32_t ke = CVTextStyle::ONE;
+			uint32_t ce[3] = { 0, 0, 0 };
+			if (GLOW) {
+				ke = glowKeep[g[x]];
+				for (int ch = 0; ch < 3; ch++)
+					ce[ch] = glowColor[g[x]][ch];
+			}
+			if (SHADOW) {
+				uint32_t ks = shadowKeep[s[x]];
+				ke = (ke * ks) >> CVTextStyle::FRACTION_BITS;
+				for (int ch = 0; ch < 3; ch++)
+					ce[ch] = (((ce[ch] >> 7) * ks) >> 8) + shadowColor[s[x]][ch];
+			}
+
+			// the first stage lets k1 of the effects through
+			for (int ch = 0; ch < 3; ch++)
+				c1[ch] = fromQ((c1[ch] << CVTextStyle::FRACTION_BITS) + ce[ch] * k1 / 255);
+			k1 = fromQ(ke * k1);
+		}
+
+		if (innerK) {
+			innerK[x] = (uchar)k2;
+			for (int ch = 0; ch < 3; ch++)
+				innerColor[3 * x + ch] = (uchar)c2[ch];
+		} else if (hasBorder) {
+			// the second stage over the first, like over a destination
+			for (int ch = 0; ch < 3; ch++)
+				c1[ch] = cvBlendSprite(c1[ch], c2[ch], k2);
+			k1 = CVTextStyle::div255(k1 * k2);
+		}
+
+		*k = (uchar)(alpha ? 255 - k1 : k1);
+		if (!color)
+			continue;
+		for (int ch = 0; ch < 3; ch++)
+			color[ch] = (uchar)c1[ch];
+		color += colorStep;
+	}
+}
+
+typedef void (*ComposeRow)(const CVTextStyle& style, const uchar* o, const uchar* t, const uchar* s, const uchar* g, int n, 
+	uchar* color, int colorStep, uchar* k, int kStep, bool alpha, uchar* innerColor, uchar* innerK);
+
+// [shadow][glow]
+static const ComposeRow kComposeRows[2][2] = {
+	{ composeRow<false, false>, composeRow<false, true> },
+	{ composeRow<true, false>, composeRow<true, true> }
+};
+
+cv::Point cvComposeSprite(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& color, cv::Mat& transmit, 
+		cv::Mat& innerColor, cv::Mat& innerTransmit) {
+	CV_Assert(outline.type() == CV_8UC1 && fill.type() == CV_8UC1 && outline.size() == fill.size());
+
+	CVEffectBuffers effects;
+	cv::Point origin = cvEffectCoverage(style, outline, fill, effects);
+	const cv::Mat& o = effects.outline;
+	const cv::Mat& f = effects.fill;
+	const cv::Mat& shadow = effects.shadow;
+	const cv::Mat& glow = effects.glow;
+	ComposeRow row = kComposeRows[!shadow.empty()][!glow.empty()];
+
+	color.create(f.size(), CV_8UC3);
+	transmit.create(f.size(), CV_8UC1);
+	if (style.hasBorder()) {
+		innerColor.create(f.size(), CV_8UC3);
+		innerTransmit.create(f.size(), CV_8UC1);
+	} else {
+		innerColor.release();
+		innerTransmit.release();
+	}
+	for (int y = 0; y < f.rows; y++) {
+		row(style, (style.hasBorder() ? o : f).ptr<uchar>(y), f.ptr<uchar>(y), shadow.empty() ? NULL : shadow.ptr<uchar>(y), 
+			glow.empty() ? NULL : glow.ptr<uchar>(y), f.cols, color.ptr<uchar>(y), 3, transmit.ptr<uchar>(y), 1, false, 
+			innerColor.empty() ? NULL : innerColor.ptr<uchar>(y), innerTransmit.empty() ? NULL : innerTransmit.ptr<uchar>(y));
+	}
+	return origin;
+}
+
+cv::Point cvComposeBGRA(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& bgra) {
+	CV_Assert(outline.type() == CV_8UC1 && fill.type() == CV_8UC1 && outline.size() == fill.size());
+
+	CVEffectBuffers effects;
+	cv::Point origin = cvEffectCoverage(style, outline, fill, effects);
+	const cv::Mat& o = effects.outline;
+	const cv::Mat& f = effects.fill;
+	const cv::Mat& shadow = effects.shadow;
+	const cv::Mat& glow = effects.glow;
+	ComposeRow row = kComposeRows[!shadow.empty()][!glow.empty()];
+
+	bgra.create(f.size(), CV_8UC4);
+	for (int y = 0; y < f.rows; y++) {
+		uchar* p = bgra.ptr<uchar>(y);
+		row(style, (style.hasBorder() ? o : f).ptr<uchar>(y), f.ptr<uchar>(y), shadow.empty() ? NULL : shadow.ptr<uchar>(y), 
+			glow.empty() ? NULL : glow.ptr<uchar>(y), f.cols, p, 4, p + 3, 4, true, NULL, NULL);
+	}
+	return origin;
+}
+
+cv::Point cvComposeAlpha(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& alpha) {
+	CV_Assert(outline.type() == CV_8UC1 && fill.type() == CV_8UC1 && outline.size() == fill.size());
+
+	CVEffectBuffers effects;
+	cv::Point origin = cvEffectCoverage(style, outline, fill, effects);
+	const cv::Mat& o = effects.outline;
+	const cv::Mat& f = effects.fill;
+	const cv::Mat& shadow = effects.shadow;
+	const cv::Mat& glow = effects.glow;
+	ComposeRow row = kComposeRows[!shadow.empty()][!glow.empty()];
+
+	alpha.create(f.size(), CV_8UC1);
+	for (int y = 0; y < f.rows; y++) {
+		row(style, (style.hasBorder() ? o : f).ptr<uchar>(y), f.ptr<uchar>(y), shadow.empty() ? NULL : shadow.ptr<uchar>(y), 
+			glow.empty() ? NULL : glow.ptr<uchar>(y), f.cols, NULL, 0, alpha.ptr<uchar>(y), 1, true, NULL, NULL);
+	}
+	return origin;
+}
+
+// n pixels of one solid colour
+static inline void fillSolid(uchar* d, const uchar* color, int n) {
+	for (int i = 0; i < n; i++, d += 3) {
+		d[0] = color[0];
+		d[1] = color[1];
+		d[2] = color[2];
+	}
+}
+
+// n pixels outside the label coverage, under the background
+static inline void blendBackground(uchar* d, uint32_t keep, const uchar* background, int n) {
+	for (int i = 0; i < n; i++, d += 3) {
+		d[0] = (uchar)std::min(CVTextStyle::div255(d[0] * keep) + background[0], 255u);
+		d[1] = (uchar)std::min(CVTextStyle::div255(d[1] * keep) + background[1], 255u);
+		d[2] = (uchar)std::min(CVTextStyle::div255(d[2] * keep) + background[2], 255u);
+	}
+}
+
+void cvBlitMask(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst) {
+	CV_Assert(dst.type() == CV_8UC3 && outline.type() == CV_8UC1 && fill.size() == outline.size());
+	CV_Assert(dst.rows <= fill.rows && (dst.cols + 7) / 8 <= fill.cols);
+
+	uchar text[3];
+	uchar border[3];
+	for (int ch = 0; ch < 3; ch++) {
+		text[ch] = cv::saturate_cast<uchar>(style.textColor()[ch]);
+		border[ch] = cv::saturate_cast<uchar>(style.brdColor()[ch]);
+	}
+	bool background = style.opacity() > 0.0;
+	uint32_t keep = style.imageKeep()[0];
+	const uchar* bgr = style.background8()[0];
+
+	for (int y = 0; y < dst.rows; y++) {
+		const uchar* o = outline.ptr<uchar>(y);
+		const uchar* t = fill.ptr<uchar>(y);
+		uchar* d = dst.ptr<uchar>(y);
+
+		int x = 0;
+		while (x < dst.cols) {
+			// whole words and bytes where the span is uniform
+			int span = (x & 31) == 0 && x + 32 <= dst.cols ? 32 : (x & 7) == 0 && x + 8 <= dst.cols ? 8 : 0;
+			if (span) {
+				uint32_t ow = o[x >> 3];
+				uint32_t tw = t[x >> 3];
+				uint32_t full = 0xFF;
+				if (span == 32) {
+					memcpy(&ow, o + (x >> 3), sizeof(ow));
+					memcpy(&tw, t + (x >> 3), sizeof(tw));
+					full = 0xFFFFFFFF;
+				}
+
+				if (tw == full) {
+					fillSolid(d + x * 3, text, span);
+					x += span;
+					continue;
+				}
+				if (tw == 0 && ow == full) {
+					fillSolid(d + x * 3, border, span);
+					x += span;
+					continue;
+				}
+				if (ow == 0 && tw == 0) {
+					if (background)
+						blendBackground(d + x * 3, keep, bgr, span);
+					x += span;
+					continue;
+				}
+			}
+
+			// mixed byte, a bit at a time
+			int end = std::min((x & ~7) + 8, dst.cols);
+			for (; x < end; x++) {
+				uchar bit = (uchar)(0x80 >> (x & 7));
+				if (t[x >> 3] & bit)
+					fillSolid(d + x * 3, text, 1);
+				else if (o[x >> 3] & bit)
+					fillSolid(d + x * 3, border, 1);
+				else if (background)
+					blendBackground(d + x * 3, keep, bgr, 1);
+			}
+		}
+	}
+}
+
+void cvBlendSpriteRow(uchar* dst, const uchar* color, const uchar* transmit, const uchar* innerColor, const uchar* innerTransmit, 
+		int width, int alpha) {
+	if (alpha >= 256) {
+		for (int x = 0; x < width; x++, dst += 3, color += 3) {
+			unsigned int k = transmit[x];
+			for (int ch = 0; ch < 3; ch++)
+				dst[ch] = cvBlendSprite(dst[ch], color[ch], k);
+		}
+		if (!innerTransmit)
+			return;
+
+		dst -= 3 * width;
+		for (int x = 0; x < width; x++, dst += 3, innerColor += 3) {
+			unsigned int k = innerTransmit[x];
+			for (int ch = 0; ch < 3; ch++)
+				dst[ch] = cvBlendSprite(dst[ch], innerColor[ch], k);
+		}
+		return;
+	}
+
+	// a fade has to apply to the label as a whole: fold the stages first,
+	// then dst * (1 - a * (1 - k)) + a * c
+	for (int x = 0; x < width; x++, dst += 3, color += 3) {
+		for (int ch = 0; ch < 3; ch++) {
+			unsigned int c = color[ch];
+			unsigned int k = transmit[x];
+			if (innerTransmit) {
+				c = cvBlendSprite(c, innerColor[3 * x + ch], innerTransmit[x]);
+				k = CVTextStyle::div255(k * innerTransmit[x]);
+			}
+			cvFadeSprite(c, k, alpha);
+			dst[ch] = cvBlendSprite(dst[ch], c, k);
+		}
+	}
+}
+
+void cvComposeSpriteRow(uchar* dstColor, uchar* dstTransmit, uchar* dstInnerColor, uchar* dstInnerTransmit, 
+		const uchar* color, const uchar* transmit, const uchar* innerColor, const uchar* innerTransmit, int width, int alpha) {
+	for (int x = 0; x < width; x++, dstColor += 3, dstInnerColor += 3, color += 3) {
+		// the label's stages a and b, b only when it has two
+		bool staged = innerTransmit != NULL;
+		unsigned int ka = transmit[x];
+		unsigned int kb = staged ? innerTransmit[x] : 255;
+		unsigned int ca[3];
+		unsigned int cb[3];
+		for (int ch = 0; ch < 3; ch++) {
+			ca[ch] = color[ch];
+			cb[ch] = staged ? innerColor[3 * x + ch] : 0;
+		}
+
+		// a fade applies to the label as a whole, fold it into one stage
+		if (alpha < 256) {
+			if (staged) {
+				for (int ch = 0; ch < 3; ch++)
+					ca[ch] = cvBlendSprite(ca[ch], cb[ch], kb);
+				ka = CVTextStyle::div255(ka * kb);
+				staged = false;
+			}
+			unsigned int k = ka;
+			for (int ch = 0; ch < 3; ch++) {
+				k = ka;
+				cvFadeSprite(ca[ch], k, alpha);
+			}
+			ka = k;
+		}
+
+		// the layer's stages fold into its first one; the label's last
+		// stage becomes the layer's second, any other goes into the first
+		unsigned int ki = dstInnerTransmit[x];
+		unsigned int k = CVTextStyle::div255(dstTransmit[x] * ki);
+		for (int ch = 0; ch < 3; ch++)
+			dstColor[ch] = cvBlendSprite(dstColor[ch], dstInnerColor[ch], ki);
+		if (staged) {
+			for (int ch = 0; ch < 3; ch++) {
+				dstColor[ch] = cvBlendSprite(dstColor[ch], ca[ch], ka);
+				ca[ch] = cb[ch];
+			}
+			k = CVTextStyle::div255(k * ka);
+			ka = kb;
+		}
+
+		dstTransmit[x] = (uchar)k;
+		dstInnerTransmit[x] = (uchar)ka;
+		for (int ch = 0; ch < 3; ch++)
+			dstInnerColor[ch] = (uchar)ca[ch];
+	}
+}
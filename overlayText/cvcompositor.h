@@ -0,0 +1,93 @@
+#ifndef CV_COMPOSITOR_H__
+#define CV_COMPOSITOR_H__
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvtextstyle.h"
+
+// Coverage of a label with its effects. Kept by the caller from call to
+// call, so the padded planes and the shadow's offset copy are reused.
+struct CVEffectBuffers
+{
+	cv::Mat outline;	// coverage padded for the effects
+	cv::Mat fill;
+	cv::Mat shadow;		// empty without a shadow
+	cv::Mat glow;		// empty without a glow
+	cv::Mat moved;		// outer coverage offset for the shadow, before its blur
+};
+
+// Pad the coverage for the style's effects into effects and build their
+// coverage. Without effects, effects.outline and effects.fill only refer to
+// outline and fill. Returns where the original coverage starts in the
+// padded one.
+cv::Point cvEffectCoverage(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, CVEffectBuffers& effects);
+
+// Blend label coverage, as CVRenderText::renderCoverage produces it, onto a
+// destination of the same size with the style's fixed-point tables, along
+// with the effect coverage of cvEffectCoverage in the same pass. The
+// destination is 8 or 16 bit with 1, 3 or 4 channels; a kernel specialised
+// for its format, the style's border/background and the shadow/glow layers
+// passed is picked from a table of template instantiations. Gray
+// destinations blend channel 0 (blue) of the style's colours, a fourth
+// channel is left as it is.
+void cvBlendCoverage(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst, 
+	const cv::Mat& shadow = cv::Mat(), const cv::Mat& glow = cv::Mat());
+
+// The same blend for CV_8UC3 with run time branches, kept as the reference
+// the specialised kernels are checked against (overlayText --check-blend).
+void cvBlendCoverageReference(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst, 
+	const cv::Mat& shadow = cv::Mat(), const cv::Mat& glow = cv::Mat());
+
+// Fold the same blend into the colour/transmission planes of a sprite, one
+// pair per 8-bit stage: color/transmit for the border (or text) over the
+// destination, innerColor/innerTransmit for the text over the border, which
+// are released for styles without border. Blended one after the other they
+// give the bytes of the 8-bit blend. The style's effects are folded into
+// the first stage and rounded once with it rather than per layer, which
+// may put them two steps off. They pad the output; the return value is
+// where the coverage starts in it.
+cv::Point cvComposeSprite(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& color, cv::Mat& transmit, 
+	cv::Mat& innerColor, cv::Mat& innerTransmit);
+
+// The same label for external compositors: premultiplied CV_8UC4 with
+// alpha = 255 - transmission, or that alpha alone as CV_8UC1. Those formats
+// have a single stage, the two are folded into it, which may be a step off
+// the 8-bit blend where the text is partly over the border.
+cv::Point cvComposeBGRA(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& bgra);
+cv::Point cvComposeAlpha(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& alpha);
+
+// Bit blit of the 1-bpp masks of CVRenderText::renderMask onto a CV_8UC3
+// destination no larger than the label: solid text colour on fill bits,
+// border colour on the other border bits, and the style's background
+// blended under the rest. Masks are tested 32 pixels at a time, so empty
+// and solid spans are written without looking at single bits.
+void cvBlitMask(const CVTextStyle& style, const cv::Mat& outline, const cv::Mat& fill, cv::Mat& dst);
+
+// A sprite value faded by alpha of 256: the colour scaled by it, the
+// transmission moved towards 255 by as much.
+inline void cvFadeSprite(unsigned int& color, unsigned int& transmit, int alpha) {
+	color = (color * alpha + 128) >> 8;
+	transmit = 255 - (((255 - transmit) * alpha + 128) >> 8);
+}
+
+// d * transmit / 255 + color, saturated
+inline uchar cvBlendSprite(unsigned int d, unsigned int color, unsigned int transmit) {
+	unsigned int v = CVTextStyle::div255(d * transmit) + color;
+	return (uchar)(v > 255 ? 255 : v);
+}
+
+// dst = dst * transmit / 255 + color over width pixels of one sprite row,
+// then the same with innerColor/innerTransmit unless they are NULL. A fade
+// by alpha of 256 folds the two stages into one first.
+void cvBlendSpriteRow(uchar* dst, const uchar* color, const uchar* transmit, const uchar* innerColor, const uchar* innerTransmit, 
+	int width, int alpha = 256);
+
+// The same over the two stages of another sprite instead of an image, for
+// layers of labels: the layer's stages fold into its first one and the
+// label takes the second, so a label over an empty layer keeps its bytes.
+// innerColor/innerTransmit may be NULL, the dst ones may not.
+void cvComposeSpriteRow(uchar* dstColor, uchar* dstTransmit, uchar* dstInnerColor, uchar* dstInnerTransmit, 
+	const uchar* color, const uchar* transmit, const uchar* innerColor, const uchar* innerTransmit, int width, int alpha = 256);
+
+#endif//CV_COMPOSITOR_H__
@@ -0,0 +1,74 @@
+#include "cvdirtyregion.h"
+
+// true when a and b overlap or share an edge
+static bool touches(const cv::Rect& a, const cv::Rect& b) {
+	return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+CVDirtyRegion::CVDirtyRegion(size_t maxRects)
+	: mMaxRects(maxRects ? maxRects : 1) {
+}
+
+void CVDirtyRegion::mergeOverlapping(size_t index) {
+	// the grown rectangle may now reach others, repeat until stable
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < mRects.size(); i++) {
+			if (i == index || !touches(mRects[i], mRects[index]))
+				continue;
+			mRects[index] |= mRects[i];
+			mRects.erase(mRects.begin() + i);
+			if (i < index)
+				index--;
+			merged = true;
+			break;
+		}
+	}
+}
+
+void CVDirtyRegion::add(const cv::Rect& rect) {
+	if (rect.area() <= 0)
+		return;
+
+	mRects.push_back(rect);
+	mergeOverlapping(mRects.size() - 1);
+
+	while (mRects.size() > mMaxRects) {
+		size_t bestA = 0;
+		size_t bestB = 1;
+		long bestWaste = -1;
+		for (size_t a = 0; a < mRects.size(); a++) {
+			for (size_t b = a + 1; b < mRects.size(); b++) {
+				long waste = (long)(mRects[a] | mRects[b]).area() - mRects[a].area() - mRects[b].area();
+				if (bestWaste < 0 || waste < bestWaste) {
+					bestWaste = waste;
+					bestA = a;
+					bestB = b;
+				}
+			}
+		}
+		mRects[bestA] |= mRects[bestB];
+		mRects.erase(mRects.begin() + bestB);
+		mergeOverlapping(bestA);
+	}
+}
+
+void CVDirtyRegion::add(const CVDirtyRegion& other) {
+	for (size_t i = 0; i < other.mRects.size(); i++)
+		add(other.mRects[i]);
+}
+
+cv::Rect CVDirtyRegion::bounds() const {
+	cv::Rect r;
+	for (size_t i = 0; i < mRects.size(); i++)
+		r = i == 0 ? mRects[i] : (r | mRects[i]);
+	return r;
+}
+
+size_t CVDirtyRegion::area() const {
+	size_t n = 0;
+	for (size_t i = 0; i < mRects.size(); i++)
+		n += mRects[i].area();
+	return n;
+}
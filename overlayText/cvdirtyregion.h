@@ -0,0 +1,36 @@
+#ifndef CV_DIRTY_REGION_H__
+#define CV_DIRTY_REGION_H__
+
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+// Accumulates the rectangles a frame's render and draw calls modified, so
+// that encoders and display uploads can work on the changed areas only.
+// Overlapping or touching rectangles are merged, and past maxRects the pair
+// whose union wastes the least area is merged as well.
+class CVDirtyRegion
+{
+protected:
+	std::vector<cv::Rect> mRects;
+	size_t mMaxRects;
+
+	void mergeOverlapping(size_t index);
+
+public:
+	explicit CVDirtyRegion(size_t maxRects = 16);
+
+	void add(const cv::Rect& rect);
+	void add(const CVDirtyRegion& other);
+	void clear() { mRects.clear(); }
+
+	const std::vector<cv::Rect>& rects() const { return mRects; }
+	bool empty() const { return mRects.empty(); }
+	// union of every rectangle
+	cv::Rect bounds() const;
+	// pixels covered, rectangles do not overlap after merging
+	size_t area() const;
+};
+
+#endif//CV_DIRTY_REGION_H__
@@ -0,0 +1,326 @@
+#include "cvglyphcache.h"
+
+size_t CVGlyphKeyHash::operator()(const CVGlyphKey& key) const {
+	// FNV-1a over the six fields
+	uint32_t h = 2166136261u;
+	const uint32_t fields[6] = { key.face, key.size, key.glyph, key.stroke, key.mode, key.hinting };
+	for (int i = 0; i < 6; i++) {
+		h ^= fields[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+CVGlyphCache::Table::Table(size_t capacity)
+	: mask(capacity - 1)
+	, slots(new std::atomic<Node*>[capacity])
+	, hand(0)
+	, used(0) {
+	for (size_t i = 0; i < capacity; i++)
+		slots[i].store(NULL, std::memory_order_relaxed);
+}
+
+CVGlyphCache::Table::~Table() {
+	delete[] slots;
+}
+
+CVGlyphCache::ReadGuard::ReadGuard(CVGlyphCache& cache, int readerId)
+	: mCache(cache)
+	, mReader(NULL)
+	, mPrevious(0)
+	, mGroup(0) {
+	if (readerId >= 0 && readerId < MAX_READERS) {
+		mReader = &cache.mReaders[readerId];
+		mPrevious = mReader->epoch.load(std::memory_order_relaxed);
+		if (mPrevious == 0)
+			mReader->epoch.store(cache.mEpoch.load());
+		return;
+	}
+
+	// join the current anonymous group; the first guard in it sets its epoch,
+	// later ones take that older epoch over
+	for (;;) {
+		mGroup = cache.mAnonGroup.load();
+		std::atomic<uint64_t>& group = cache.mAnonGroups[mGroup];
+		uint64_t value = group.load();
+		uint64_t count = value & ANON_COUNT_MASK;
+		uint64_t epoch = count ? value >> ANON_COUNT_BITS : cache.mEpoch.load();
+		if (count < ANON_COUNT_MASK && group.compare_exchange_weak(value, (epoch << ANON_COUNT_BITS) | (count + 1)))
+			break;
+	}
+}
+
+CVGlyphCache::ReadGuard::~ReadGuard() {
+	if (mReader)
+		mReader->epoch.store(mPrevious, std::memory_order_release);
+	else
+		mCache.mAnonGroups[mGroup].fetch_sub(1);
+}
+
+CVGlyphCache::CVGlyphCache(size_t maxGlyphs)
+	: mAnonGroup(0)
+	, mEpoch(1)
+	, mCount(0)
+	, mMaxGlyphs(maxGlyphs) {
+	if (mMaxGlyphs == 0)
+		mMaxGlyphs = 1;
+
+	// keep the load factor, tombstones included, at most 3/4
+	mCapacity = 16;
+	while (mCapacity < mMaxGlyphs * 2)
+		mCapacity *= 2;
+
+	for (int i = 0; i < MAX_READERS; i++) {
+		mReaders[i].epoch.store(0);
+		mReaders[i].registered.store(false);
+	}
+	mAnonGroups[0].store(0);
+	mAnonGroups[1].store(0);
+	mTombstone.referenced.store(false);
+	mTable.store(new Table(mCapacity));
+}
+
+CVGlyphCache::~CVGlyphCache() {
+	Table* table = mTable.load();
+	for (size_t i = 0; i <= table->mask; i++) {
+		Node* node = table->slots[i].load();
+		if (node && node != &mTombstone)
+			delete node;
+	}
+	delete table;
+
+	for (size_t i = 0; i < mRetiredNodes.size(); i++)
+		delete mRetiredNodes[i].second;
+	for (size_t i = 0; i < mRetiredTables.size(); i++)
+		delete mRetiredTables[i].second;
+}
+
+int CVGlyphCache::registerReader() {
+	for (int i = 0; i < MAX_READERS; i++) {
+		bool expected = false;
+		if (mReaders[i].registered.compare_exchange_strong(expected, true))
+			return i;
+	}
+	return -1;
+}
+
+void CVGlyphCache::unregisterReader(int readerId) {
+	if (readerId >= 0 && readerId < MAX_READERS) {
+		mReaders[readerId].epoch.store(0);
+		mReaders[readerId].registered.store(false);
+	}
+}
+
+uint32_t CVGlyphCache::faceId(const std::string& fontPath) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::map<std::string, uint32_t>::iterator it = mFaces.find(fontPath);
+	if (it != mFaces.end())
+		return it->second;
+
+	uint32_t id = (uint32_t)mFaces.size() + 1;
+	mFaces[fontPath] = id;
+	return id;
+}
+
+const CVGlyphCache::Node* CVGlyphCache::probe(const Table* table, const CVGlyphKey& key) const {
+	size_t h = CVGlyphKeyHash()(key);
+	// at most one pass over the table, so lookups finish in bounded steps
+	for (size_t i = 0; i <= table->mask; i++) {
+		// sequentially consistent, so that a reader entering its epoch either
+		// is seen by reclaim() or sees the slot already unlinked
+		const Node* node = table->slots[(h + i) & table->mask].load();
+		if (!node)
+			return NULL;
+		if (node != &mTombstone && node->key == key)
+			return node;
+	}
+	return NULL;
+}
+
+const CVGlyph* CVGlyphCache::find(const CVGlyphKey& key) const {
+	const Node* node = probe(mTable.load(), key);
+	if (!node)
+		return NULL;
+
+	// only write the CLOCK bit when it changes, to keep the line shared
+	Node* mutableNode = const_cast<Node*>(node);
+	if (!mutableNode->referenced.load(std::memory_order_relaxed))
+		mutableNode->referenced.store(true, std::memory_order_relaxed);
+	return &node->glyph;
+}
+
+const CVGlyph* CVGlyphCache::insert(const CVGlyphKey& key, const CVGlyph& glyph) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const Node* existing = probe(mTable.load(), key);
+	if (existing)
+		return &existing->glyph;
+
+	if (mCount.load() >= mMaxGlyphs)
+		evictOne(mTable.load());
+
+	Table* table = mTable.load();
+	if ((table->used + 1) * 4 > mCapacity * 3) {
+		rebuild();
+		table = mTable.load();
+	}
+
+	Node* node = new Node;
+	node->key = key;
+	node->glyph = glyph;
+	node->referenced.store(true, std::memory_order_relaxed);
+
+	size_t h = CVGlyphKeyHash()(key);
+	for (size_t i = 0; i <= table->mask; i++) {
+		std::atomic<Node*>& slot = table->slots[(h + i) & table->mask];
+		Node* current = slot.load();
+		if (!current || current == &mTombstone) {
+			if (!current)
+				table->used++;
+			slot.store(node);
+			break;
+		}
+	}
+	mCount++;
+
+	if (mRetiredNodes.size() >= 64 || !mRetiredTables.empty())
+		reclaim();
+
+	return &node->glyph;
+}
+
+void CVGlyphCache::evictOne(Table* table) {
+	// CLOCK: skip entries read since the last sweep, clearing their bit
+	for (size_t n = 0; n <= 2 * table->mask + 1; n++) {
+		std::atomic<Node*>& slot = table->slots[table->hand];
+		table->hand = (table->hand + 1) & table->mask;
+
+		Node* node = slot.load();
+		if (!node || node == &mTombstone)
+			continue;
+		if (node->referenced.load(std::memory_order_relaxed)) {
+			node->referenced.store(false, std::memory_order_relaxed);
+			continue;
+		}
+
+		slot.store(&mTombstone);
+		mCount--;
+		retire(node);
+		return;
+	}
+}
+
+void CVGlyphCache::rebuild() {
+	// publish a copy without tombstones; readers still on the old table keep
+	// using it until they leave their epoch
+	Table* old = mTable.load();
+	Table* table = new Table(mCapacity);
+
+	for (size_t i = 0; i <= old->mask; i++) {
+		Node* node = old->slots[i].load();
+		if (!node || node == &mTombstone)
+			continue;
+
+		size_t h = CVGlyphKeyHash()(node->key);
+		for (size_t j = 0; j <= table->mask; j++) {
+			std::atomic<Node*>& slot = table->slots[(h + j) & table->mask];
+			if (!slot.load(std::memory_order_relaxed)) {
+				slot.store(node, std::memory_order_relaxed);
+				table->used++;
+				break;
+			}
+		}
+	}
+
+	mTable.store(table);
+	mRetiredTables.push_back(std::make_pair(mEpoch.fetch_add(1), old));
+}
+
+void CVGlyphCache::retire(Node* node) {
+	mRetiredNodes.push_back(std::make_pair(mEpoch.fetch_add(1), node));
+}
+
+void CVGlyphCache::reclaim() {
+	// send new anonymous guards to the other group once it has drained, so
+	// that the current one can drain in turn
+	int current = mAnonGroup.load();
+	if ((mAnonGroups[1 - current].load() & ANON_COUNT_MASK) == 0)
+		mAnonGroup.store(1 - current);
+
+	// anything retired before the oldest active reader entered is unreachable
+	uint64_t oldest = mEpoch.load();
+	for (int i = 0; i < MAX_READERS; i++) {
+		uint64_t epoch = mReaders[i].epoch.load();
+		if (epoch != 0 && epoch < oldest)
+			oldest = epoch;
+	}
+	for (int g = 0; g < 2; g++) {
+		uint64_t value = mAnonGroups[g].load();
+		if ((value & ANON_COUNT_MASK) != 0 && (value >> ANON_COUNT_BITS) < oldest)
+			oldest = value >> ANON_COUNT_BITS;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < mRetiredNodes.size(); i++) {
+		if (mRetiredNodes[i].first < oldest)
+			delete mRetiredNodes[i].second;
+		else
+			mRetiredNodes[kept++] = mRetiredNodes[i];
+	}
+	mRetiredNodes.resize(kept);
+
+	kept = 0;
+	for (size_t i = 0; i < mRetiredTables.size(); i++) {
+		if (mRetiredTables[i].first < oldest)
+			delete mRetiredTables[i].second;
+		else
+			mRetiredTables[kept++] = mRetiredTables[i];
+	}
+	mRetiredTables.resize(kept);
+}
+
+void CVGlyphCache::clear() {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Table* old = mTable.load();
+	mTable.store(new Table(mCapacity));
+	mCount.store(0);
+
+	for (size_t i = 0; i <= old->mask; i++) {
+		Node* node = old->slots[i].load();
+		if (node && node != &mTombstone)
+			retire(node);
+	}
+	mRetiredTables.push_back(std::make_pair(mEpoch.fetch_add(1), old));
+	reclaim();
+}
+
+size_t CVGlyphCache::size() const {
+	return mCount.load();
+}
+
+size_t CVGlyphCache::retired() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mRetiredNodes.size() + mRetiredTables.size();
+}
+
+size_t CVGlyphCache::footprint(uint32_t hinting, size_t* glyphs) {
+	// writers are excluded, so the table and its nodes stay put
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	size_t bytes = 0;
+	size_t count = 0;
+	Table* table = mTable.load();
+	for (size_t i = 0; i <= table->mask; i++) {
+		const Node* node = table->slots[i].load();
+		if (!node || node == &mTombstone || node->key.hinting != hinting)
+			continue;
+
+		bytes += sizeof(Node) + node->glyph.bitmap.total() * node->glyph.bitmap.elemSize();
+		count++;
+	}
+
+	if (glyphs)
+		*glyphs = count;
+	return bytes;
+}
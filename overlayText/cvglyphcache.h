@@ -0,0 +1,178 @@
+#ifndef CV_GLYPH_CACHE_H__
+#define CV_GLYPH_CACHE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+// Identifies one rasterized glyph: font file, pixel size, glyph index,
+// border radius (0 means the plain fill glyph), render mode and hinting
+// preset. Every preset thus has its own partition of the cache.
+struct CVGlyphKey
+{
+	enum { ANTIALIASED = 0, MONO = 1 };
+
+	uint32_t face;
+	uint32_t size;
+	uint32_t glyph;
+	uint32_t stroke;
+	uint32_t mode;
+	uint32_t hinting;
+
+	CVGlyphKey()
+		: face(0), size(0), glyph(0), stroke(0), mode(ANTIALIASED), hinting(0) {}
+	CVGlyphKey(uint32_t f, uint32_t sz, uint32_t g, uint32_t st, uint32_t m = ANTIALIASED, uint32_t h = 0)
+		: face(f), size(sz), glyph(g), stroke(st), mode(m), hinting(h) {}
+
+	bool operator==(const CVGlyphKey& other) const {
+		return face == other.face && size == other.size && glyph == other.glyph && stroke == other.stroke 
+			&& mode == other.mode && hinting == other.hinting;
+	}
+};
+
+struct CVGlyphKeyHash
+{
+	size_t operator()(const CVGlyphKey& key) const;
+};
+
+// A glyph bitmap and the metrics renderText needs to place it.
+struct CVGlyph
+{
+	cv::Mat bitmap;	// CV_8UC1 coverage, or packed 1-bpp rows for mono; owns its pixels
+	int monoWidth;	// pixel width of a packed mono bitmap, 0 for coverage
+	int left;		// bitmap_left
+	int top;		// bbox.yMax
+	int bottom;		// bbox.yMin
+	int right;		// bbox.xMax
+	int advance;	// horizontal advance in whole pixels
+
+	CVGlyph()
+		: monoWidth(0), left(0), top(0), bottom(0), right(0), advance(0) {}
+};
+
+// Glyph cache that can be shared by several CVRenderText instances (and their
+// background preparation threads). Faces are identified by font path so that
+// renderers opening the same file share entries.
+//
+// Lookups are wait-free: the table is open addressing over atomic entry
+// pointers and a reader never takes a lock. Inserts, evictions and table
+// rebuilds are serialized by a mutex, and the entries and tables they unlink
+// are only freed once no reader that could still see them is active
+// (epoch based reclamation). Readers therefore have to register once and
+// hold a ReadGuard while they use the pointers returned by find/insert.
+class CVGlyphCache
+{
+protected:
+	struct Node {
+		CVGlyphKey key;
+		CVGlyph glyph;
+		std::atomic<bool> referenced;	// CLOCK bit, set by readers
+	};
+
+	struct Table {
+		size_t mask;
+		std::atomic<Node*>* slots;
+		size_t hand;		// CLOCK hand, only used by writers
+		size_t used;		// live entries plus tombstones
+
+		explicit Table(size_t capacity);
+		~Table();
+	};
+
+	// per-reader announcement of the epoch it entered, 0 when idle;
+	// padded so readers do not share cache lines
+	struct Reader {
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool> registered;
+		char pad[64 - sizeof(uint64_t) - sizeof(bool)];
+	};
+	enum { MAX_READERS = 256 };
+
+	// Readers without an id share two groups, each the count of its guards
+	// (low ANON_COUNT_BITS) and the epoch the first of them entered. New
+	// guards join mAnonGroup, and reclaim() switches it once the other group
+	// has drained, so the pinned epoch keeps moving under steady traffic.
+	enum { ANON_COUNT_BITS = 16 };
+	static const uint64_t ANON_COUNT_MASK = (1u << ANON_COUNT_BITS) - 1;
+
+	std::atomic<Table*> mTable;
+	Reader mReaders[MAX_READERS];
+	std::atomic<uint64_t> mAnonGroups[2];
+	std::atomic<int> mAnonGroup;
+	std::atomic<uint64_t> mEpoch;
+	std::atomic<size_t> mCount;
+	Node mTombstone;
+
+	// writer state
+	std::mutex mMutex;
+	std::vector<std::pair<uint64_t, Node*> > mRetiredNodes;
+	std::vector<std::pair<uint64_t, Table*> > mRetiredTables;
+	std::map<std::string, uint32_t> mFaces;
+	size_t mMaxGlyphs;
+	size_t mCapacity;
+
+	const Node* probe(const Table* table, const CVGlyphKey& key) const;
+	void evictOne(Table* table);
+	void rebuild();
+	void retire(Node* node);
+	void reclaim();
+
+private:
+	CVGlyphCache(const CVGlyphCache&);
+	CVGlyphCache& operator=(const CVGlyphCache&);
+
+public:
+	explicit CVGlyphCache(size_t maxGlyphs = 8192);
+	virtual ~CVGlyphCache();
+
+	// Pins the calling reader to the current epoch for the guard's lifetime.
+	// Guards nest: an inner guard keeps the outer one's epoch.
+	class ReadGuard
+	{
+		CVGlyphCache& mCache;
+		Reader* mReader;
+		uint64_t mPrevious;	// epoch of an enclosing guard, 0 for none
+		int mGroup;			// anonymous group joined, without a reader
+		ReadGuard(const ReadGuard&);
+		ReadGuard& operator=(const ReadGuard&);
+	public:
+		ReadGuard(CVGlyphCache& cache, int readerId);
+		~ReadGuard();
+	};
+
+	// each thread that reads the cache needs its own reader id; -1 is a
+	// valid id for readers that could not get one (beyond MAX_READERS), whose
+	// guards pin a shared, older epoch
+	int registerReader();
+	void unregisterReader(int readerId);
+
+	// stable id of a font file, allocated on first use
+	uint32_t faceId(const std::string& fontPath);
+
+	// wait-free, returns NULL on miss; the pointer stays valid while the
+	// caller's ReadGuard is alive
+	const CVGlyph* find(const CVGlyphKey& key) const;
+
+	// returns the cached entry, which is the existing one if another thread
+	// inserted the same key first; the caller must hold a ReadGuard
+	const CVGlyph* insert(const CVGlyphKey& key, const CVGlyph& glyph);
+
+	void clear();
+	size_t size() const;
+
+	// unlinked entries and tables not freed yet
+	size_t retired();
+
+	// bytes held by the glyphs of one hinting partition, bitmaps and entries;
+	// glyphs gets their number
+	size_t footprint(uint32_t hinting, size_t* glyphs = NULL);
+};
+
+#endif//CV_GLYPH_CACHE_H__
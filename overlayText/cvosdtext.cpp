@@ -0,0 +1,135 @@
+#include "cvosdtext.h"
+
+// coverage of one piece of the line and where its baseline is
+struct OsdPiece {
+	cv::Mat outline;
+	cv::Mat fill;
+	int baseline;
+	int x;
+	int width;
+};
+
+CVOsdText::CVOsdText()
+	: mCellWidth(0) {
+}
+
+int CVOsdText::create(CVRenderText& renderer, const wchar_t* format, size_t textSize, cv::Scalar textColor, 
+		bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) {
+	return create(renderer, format, CVTextStyle(textSize, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity));
+}
+
+int CVOsdText::create(CVRenderText& renderer, const wchar_t* format, const CVTextStyle& style) {
+	mCells.clear();
+	mCellWidth = 0;
+
+	// digit table
+	OsdPiece digits[10];
+	for (int d = 0; d < 10; d++) {
+		wchar_t text[2] = { (wchar_t)(L'0' + d), 0 };
+		int error = renderer.renderCoverage(CVTextView::wide(text), style, digits[d].outline, digits[d].fill, &digits[d].baseline);
+		if (error != 0)
+			return error;
+		mCellWidth = std::max(mCellWidth, digits[d].fill.cols);
+	}
+
+	// static segments between the digit cells
+	std::vector<OsdPiece> segments;
+	std::wstring segment;
+	int x = 0;
+	for (const wchar_t* p = format; ; p++) {
+		if ((*p == L'#' || *p == 0) && !segment.empty()) {
+			OsdPiece piece;
+			int error = renderer.renderCoverage(CVTextView(segment.c_str(), segment.size()), style, piece.outline, piece.fill, &piece.baseline);
+			if (error != 0)
+				return error;
+			piece.x = x;
+			piece.width = piece.fill.cols;
+			x += piece.width;
+			segments.push_back(piece);
+			segment.clear();
+		}
+
+		if (*p == 0)
+			break;
+
+		if (*p == L'#') {
+			Cell cell;
+			cell.x = x;
+			cell.digit = 0;
+			mCells.push_back(cell);
+			x += mCellWidth;
+		} else {
+			segment.push_back(*p);
+		}
+	}
+
+	// common box over every piece that can appear on the line
+	int ascent = 0;
+	int descent = 0;
+	for (int d = 0; d < 10; d++) {
+		ascent = std::max(ascent, digits[d].baseline);
+		descent = std::max(descent, digits[d].fill.rows - digits[d].baseline);
+	}
+	for (size_t i = 0; i < segments.size(); i++) {
+		ascent = std::max(ascent, segments[i].baseline);
+		descent = std::max(descent, segments[i].fill.rows - segments[i].baseline);
+	}
+	int height = ascent + descent;
+
+	cv::Mat outline(height, x, CV_8UC1, cv::Scalar::all(0));
+	cv::Mat fill(height, x, CV_8UC1, cv::Scalar::all(0));
+	for (size_t i = 0; i < segments.size(); i++) {
+		const OsdPiece& piece = segments[i];
+		cv::Rect rect(piece.x, ascent - piece.baseline, piece.width, piece.fill.rows);
+		piece.outline.copyTo(outline(rect));
+		piece.fill.copyTo(fill(rect));
+	}
+	mLabel.compose(outline, fill, style);
+	mLabel.baseline = ascent + mLabel.origin.y;
+
+	// digit sprites centered in a full height cell, background included
+	cv::Mat cellOutline(height, mCellWidth, CV_8UC1);
+	cv::Mat cellFill(height, mCellWidth, CV_8UC1);
+	for (int d = 0; d < 10; d++) {
+		cellOutline.setTo(cv::Scalar::all(0));
+		cellFill.setTo(cv::Scalar::all(0));
+		cv::Rect rect((mCellWidth - digits[d].fill.cols) / 2, ascent - digits[d].baseline, digits[d].fill.cols, digits[d].fill.rows);
+		digits[d].outline.copyTo(cellOutline(rect));
+		digits[d].fill.copyTo(cellFill(rect));
+		mDigits[d].compose(cellOutline, cellFill, style);
+		mDigits[d].baseline = ascent + mDigits[d].origin.y;
+	}
+
+	return 0;
+}
+
+void CVOsdText::setCell(Cell& cell, char digit) {
+	const CVTextSprite& sprite = mDigits[digit - '0'];
+	// only the cell itself; effects spilling out of it are not carried over
+	cv::Rect src(sprite.origin.x, 0, mCellWidth, mLabel.size().height);
+	cv::Rect rect(mLabel.origin.x + cell.x, 0, mCellWidth, mLabel.size().height);
+	sprite.roi(src).copyTo(mLabel, rect);
+	cell.digit = digit;
+}
+
+int CVOsdText::update(const char* digits) {
+	int changed = 0;
+	size_t i = 0;
+	for (const char* p = digits; *p && i < mCells.size(); p++) {
+		if (*p < '0' || *p > '9')
+			continue;
+		if (mCells[i].digit != *p) {
+			setCell(mCells[i], *p);
+			changed++;
+		}
+		i++;
+	}
+	return changed;
+}
+
+cv::Rect CVOsdText::draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, double alpha, 
+		CVSaveUnder* saveUnder) const {
+	if (mLabel.empty())
+		return cv::Rect();
+	return mLabel.draw(dstImg, pos, xMargin, yMargin, alpha, saveUnder);
+}
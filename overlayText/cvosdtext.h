@@ -0,0 +1,55 @@
+#ifndef CV_OSD_TEXT_H__
+#define CV_OSD_TEXT_H__
+
+#include <string>
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+#include "cvtextsprite.h"
+
+// On-screen display line such as "CAM-12  ####-##-## ##:##:##.###" where
+// each '#' is a digit that changes from frame to frame. The static text is
+// rendered once; every digit cell has the same advance, taken from a table
+// of pre-rendered digit sprites, so the layout never shifts and an update
+// only copies the cells whose digit changed.
+class CVOsdText
+{
+protected:
+	struct Cell {
+		int x;			// left edge in the label
+		char digit;		// digit shown, 0 before the first update
+	};
+
+	CVTextSprite mLabel;
+	CVTextSprite mDigits[10];
+	std::vector<Cell> mCells;
+	int mCellWidth;
+
+	void setCell(Cell& cell, char digit);
+
+public:
+	CVOsdText();
+
+	// '#' in format marks a digit cell; returns the renderer's error code
+	int create(CVRenderText& renderer, const wchar_t* format, const CVTextStyle& style);
+	int create(CVRenderText& renderer, const wchar_t* format, size_t textSize, cv::Scalar textColor = cv::Scalar::all(255), 
+		bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, 
+		cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+
+	// one digit per cell, in order; other characters are skipped. Returns the
+	// number of cells that changed.
+	int update(const char* digits);
+
+	cv::Rect draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin = CVRenderText::LEFT_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::TOP_MARGIN, double alpha = 1.0, CVSaveUnder* saveUnder = NULL) const;
+
+	size_t cellCount() const { return mCells.size(); }
+	// the composited line, updated in place by update
+	const CVTextSprite& sprite() const { return mLabel; }
+	cv::Size size() const { return mLabel.size(); }
+};
+
+#endif//CV_OSD_TEXT_H__
@@ -0,0 +1,186 @@
+#include "cvoverlaylayer.h"
+#include "cvcompositor.h"
+
+CVOverlayLayer::CVOverlayLayer(cv::Size frameSize, int tileSize)
+	: mFrameSize(frameSize)
+	, mTileSize(std::max(tileSize, 8))
+	, mAnyDirty(false)
+	, mNextId(1) {
+	mTilesX = (mFrameSize.width + mTileSize - 1) / mTileSize;
+	mTilesY = (mFrameSize.height + mTileSize - 1) / mTileSize;
+	mTouched.assign(mTilesX * mTilesY, 0);
+	mDirty.assign(mTilesX * mTilesY, 0);
+	mColor.create(mFrameSize, CV_8UC3);
+	mTransmit.create(mFrameSize, CV_8UC1);
+	mInnerColor.create(mFrameSize, CV_8UC3);
+	mInnerTransmit.create(mFrameSize, CV_8UC1);
+}
+
+void CVOverlayLayer::invalidate(const cv::Rect& rect) {
+	if (rect.area() <= 0)
+		return;
+
+	int x1 = (rect.x + rect.width - 1) / mTileSize;
+	int y1 = (rect.y + rect.height - 1) / mTileSize;
+	for (int ty = rect.y / mTileSize; ty <= y1; ty++)
+		for (int tx = rect.x / mTileSize; tx <= x1; tx++)
+			mDirty[ty * mTilesX + tx] = 1;
+	mAnyDirty = true;
+}
+
+int CVOverlayLayer::add(const CVTextSprite& sprite, cv::Point pos, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, double alpha) {
+	int id = mNextId++;
+	Label& label = mLabels[id];
+	label.sprite = sprite;
+	label.alpha = std::min(std::max(alpha, 0.0), 1.0);
+	label.visible = true;
+	label.rect = sprite.empty() ? cv::Rect() : CVRenderText::labelRect(sprite.size(), pos, xMargin, yMargin, mFrameSize);
+	invalidate(label.rect);
+	return id;
+}
+
+void CVOverlayLayer::update(int id, const CVTextSprite& sprite) {
+	std::map<int, Label>::iterator it = mLabels.find(id);
+	if (it == mLabels.end())
+		return;
+
+	// keep the top left corner, the size may change
+	Label& label = it->second;
+	invalidate(label.rect);
+	cv::Point pos = label.rect.tl();
+	label.sprite = sprite;
+	label.rect = sprite.empty() ? cv::Rect() : CVRenderText::labelRect(sprite.size(), pos, CVRenderText::LEFT_MARGIN, CVRenderText::TOP_MARGIN, mFrameSize);
+	invalidate(label.rect);
+}
+
+void CVOverlayLayer::update(int id) {
+	std::map<int, Label>::iterator it = mLabels.find(id);
+	if (it != mLabels.end())
+		invalidate(it->second.rect);
+}
+
+void CVOverlayLayer::move(int id, cv::Point pos, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin) {
+	std::map<int, Label>::iterator it = mLabels.find(id);
+	if (it == mLabels.end())
+		return;
+
+	Label& label = it->second;
+	invalidate(label.rect);
+	label.rect = label.sprite.empty() ? cv::Rect() : CVRenderText::labelRect(label.sprite.size(), pos, xMargin, yMargin, mFrameSize);
+	invalidate(label.rect);
+}
+
+void CVOverlayLayer::setAlpha(int id, double alpha) {
+	std::map<int, Label>::iterator it = mLabels.find(id);
+	if (it == mLabels.end())
+		return;
+	it->second.alpha = std::min(std::max(alpha, 0.0), 1.0);
+	invalidate(it->second.rect);
+}
+
+void CVOverlayLayer::setVisible(int id, bool visible) {
+	std::map<int, Label>::iterator it = mLabels.find(id);
+	if (it == mLabels.end() || it->second.visible == visible)
+		return;
+	it->second.visible = visible;
+	invalidate(it->second.rect);
+}
+
+void CVOverlayLayer::remove(int id) {
+	std::map<int, Label>::iterator it = mLabels.find(id);
+	if (it == mLabels.end())
+		return;
+	invalidate(it->second.rect);
+	mLabels.erase(it);
+}
+
+void CVOverlayLayer::clear() {
+	mLabels.clear();
+	mTouched.assign(mTouched.size(), 0);
+	mDirty.assign(mDirty.size(), 0);
+	mAnyDirty = false;
+}
+
+void CVOverlayLayer::rebuildTile(int tx, int ty) {
+	cv::Rect tile = cv::Rect(tx * mTileSize, ty * mTileSize, mTileSize, mTileSize) & cv::Rect(cv::Point(0, 0), mFrameSize);
+	bool touched = false;
+
+	// empty layer: keep all of the frame
+	mColor(tile).setTo(cv::Scalar::all(0));
+	mTransmit(tile).setTo(cv::Scalar::all(255));
+	mInnerColor(tile).setTo(cv::Scalar::all(0));
+	mInnerTransmit(tile).setTo(cv::Scalar::all(255));
+
+	for (std::map<int, Label>::const_iterator it = mLabels.begin(); it != mLabels.end(); ++it) {
+		const Label& label = it->second;
+		cv::Rect area = label.rect & tile;
+		if (!label.visible || label.alpha <= 0.0 || area.area() <= 0)
+			continue;
+		touched = true;
+
+		// label over the layer: k = k * ks, c = c * ks + cs, faded by alpha
+		int a = cvRound(label.alpha * 256);
+		int sx = area.x - label.rect.x;
+		int sy = area.y - label.rect.y;
+		const CVTextSprite& sprite = label.sprite;
+		for (int y = 0; y < area.height; y++) {
+			cvComposeSpriteRow(mColor.ptr<uchar>(area.y + y) + 3 * area.x, mTransmit.ptr<uchar>(area.y + y) + area.x, 
+				mInnerColor.ptr<uchar>(area.y + y) + 3 * area.x, mInnerTransmit.ptr<uchar>(area.y + y) + area.x, 
+				sprite.color.ptr<uchar>(sy + y) + 3 * sx, sprite.transmit.ptr<uchar>(sy + y) + sx, 
+				sprite.staged() ? sprite.innerColor.ptr<uchar>(sy + y) + 3 * sx : NULL, 
+				sprite.staged() ? sprite.innerTransmit.ptr<uchar>(sy + y) + sx : NULL, area.width, a);
+		}
+	}
+
+	mTouched[ty * mTilesX + tx] = touched ? 1 : 0;
+	mDirty[ty * mTilesX + tx] = 0;
+}
+
+void CVOverlayLayer::rebuild() {
+	if (!mAnyDirty)
+		return;
+	for (int ty = 0; ty < mTilesY; ty++)
+		for (int tx = 0; tx < mTilesX; tx++)
+			if (mDirty[ty * mTilesX + tx])
+				rebuildTile(tx, ty);
+	mAnyDirty = false;
+}
+
+void CVOverlayLayer::apply(cv::Mat& frame, CVDirtyRegion* dirty) {
+	CV_Assert(frame.type() == CV_8UC3 && frame.size() == mFrameSize);
+	rebuild();
+
+	// row by row over runs of touched tiles, so the frame is streamed once
+	for (int ty = 0; ty < mTilesY; ty++) {
+		const uchar* touched = &mTouched[ty * mTilesX];
+		int y0 = ty * mTileSize;
+		int y1 = std::min(y0 + mTileSize, mFrameSize.height);
+
+		for (int tx = 0; tx < mTilesX; ) {
+			if (!touched[tx]) {
+				tx++;
+				continue;
+			}
+			int run = tx;
+			while (run < mTilesX && touched[run])
+				run++;
+
+			int x0 = tx * mTileSize;
+			int width = std::min(run * mTileSize, mFrameSize.width) - x0;
+			for (int y = y0; y < y1; y++) {
+				cvBlendSpriteRow(frame.ptr<uchar>(y) + 3 * x0, mColor.ptr<uchar>(y) + 3 * x0, mTransmit.ptr<uchar>(y) + x0, 
+					mInnerColor.ptr<uchar>(y) + 3 * x0, mInnerTransmit.ptr<uchar>(y) + x0, width);
+			}
+			if (dirty)
+				dirty->add(cv::Rect(x0, y0, width, y1 - y0));
+			tx = run;
+		}
+	}
+}
+
+size_t CVOverlayLayer::touchedTiles() const {
+	size_t n = 0;
+	for (size_t i = 0; i < mTouched.size(); i++)
+		n += mTouched[i];
+	return n;
+}
@@ -0,0 +1,81 @@
+#ifndef CV_OVERLAY_LAYER_H__
+#define CV_OVERLAY_LAYER_H__
+
+#include <map>
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvdirtyregion.h"
+#include "cvrendertext.h"
+#include "cvtextsprite.h"
+
+// A set of positioned labels merged into one frame sized sprite layer
+// (premultiplied colour plus transmission, in two stages like a sprite's),
+// kept per tile. Changing a label only marks the tiles under its old and new
+// rectangles for rebuild; apply then blends the layer onto a frame in one
+// pass over the tiles that any label touches, instead of one pass per label.
+//
+// Labels are drawn in the order they were added. The layer keeps headers
+// to the sprites' pixels: call update after changing them in place (a
+// CVOsdText after its update, for instance).
+class CVOverlayLayer
+{
+protected:
+	struct Label {
+		CVTextSprite sprite;
+		cv::Rect rect;		// in the frame, clipped
+		double alpha;
+		bool visible;
+	};
+
+	cv::Size mFrameSize;
+	int mTileSize;
+	int mTilesX;
+	int mTilesY;
+
+	// the labels under the top one, and the top one's last stage, so a
+	// label alone on its tiles draws the bytes of its sprite
+	cv::Mat mColor;		// CV_8UC3
+	cv::Mat mTransmit;	// CV_8UC1
+	cv::Mat mInnerColor;
+	cv::Mat mInnerTransmit;
+	std::vector<uchar> mTouched;	// per tile, some label covers it
+	std::vector<uchar> mDirty;		// per tile, needs a rebuild
+	bool mAnyDirty;
+
+	std::map<int, Label> mLabels;
+	int mNextId;
+
+	void invalidate(const cv::Rect& rect);
+	void rebuildTile(int tx, int ty);
+	void rebuild();
+
+public:
+	explicit CVOverlayLayer(cv::Size frameSize, int tileSize = 64);
+
+	// returns the label id
+	int add(const CVTextSprite& sprite, cv::Point pos, CVRenderText::Justify xMargin = CVRenderText::CENTER_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::CENTER_MARGIN, double alpha = 1.0);
+
+	// replace the label's pixels, or re-read them after an in-place change
+	void update(int id, const CVTextSprite& sprite);
+	void update(int id);
+	void move(int id, cv::Point pos, CVRenderText::Justify xMargin = CVRenderText::CENTER_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::CENTER_MARGIN);
+	void setAlpha(int id, double alpha);
+	void setVisible(int id, bool visible);
+	void remove(int id);
+	void clear();
+
+	// rebuild the changed tiles, then blend the layer onto a CV_8UC3 frame
+	// of the layer's size; the blended tile runs are added to dirty
+	void apply(cv::Mat& frame, CVDirtyRegion* dirty = NULL);
+
+	cv::Size frameSize() const { return mFrameSize; }
+	size_t labelCount() const { return mLabels.size(); }
+	size_t touchedTiles() const;
+};
+
+#endif//CV_OVERLAY_LAYER_H__
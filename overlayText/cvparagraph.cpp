@@ -0,0 +1,273 @@
+#include "cvparagraph.h"
+#include "cvcompositor.h"
+
+static bool isSpace(uint32_t c) {
+	return c == ' ' || c == '\t' || c == 0x3000;
+}
+
+// scripts written without spaces, where a line may break around any character
+static bool isIdeograph(uint32_t c) {
+	return (c >= 0x2E80 && c <= 0x9FFF) || (c >= 0xF900 && c <= 0xFAFF) || (c >= 0xFF00 && c <= 0xFFEF) || (c >= 0x20000 && c <= 0x2FFFF);
+}
+
+static CVTextView codePoints(const std::vector<uint32_t>& text, size_t begin, size_t end) {
+	if (begin >= end)
+		return CVTextView();
+	return CVTextView(&text[begin], end - begin);
+}
+
+bool CVParagraph::BreakKey::operator<(const BreakKey& other) const {
+	if (maxWidth != other.maxWidth)
+		return maxWidth < other.maxWidth;
+	if (textSize != other.textSize)
+		return textSize < other.textSize;
+	if (stroke != other.stroke)
+		return stroke < other.stroke;
+	if (font != other.font)
+		return font < other.font;
+	if (hinting != other.hinting)
+		return hinting < other.hinting;
+	if (renderMode != other.renderMode)
+		return renderMode < other.renderMode;
+	if (layout != other.layout)
+		return layout < other.layout;
+	return text < other.text;
+}
+
+CVParagraph::CVParagraph(CVRenderText& renderer)
+	: mRenderer(renderer)
+	, mMaxWidth(0)
+	, mLineSpacing(1.0)
+	, mAlign(CVRenderText::CENTER_MARGIN)
+	, mMaxCached(256)
+	, mLaidOut(false)
+	, mRendered(false) {
+}
+
+bool CVParagraph::isCurrent(const CVTextView& text, const CVTextStyle& style) const {
+	if (!mLaidOut || mKey.maxWidth != mMaxWidth || mKey.textSize != style.textSize() || mKey.stroke != style.strokeRadius() 
+			|| mKey.hinting != mRenderer.hinting() || mKey.renderMode != mRenderer.renderMode() || mKey.layout != mRenderer.layout() 
+			|| mKey.font != mRenderer.fontName())
+		return false;
+
+	size_t i = 0;
+	for (size_t pos = 0; pos < text.length(); i++) {
+		if (i == mKey.text.size() || text.next(pos) != mKey.text[i])
+			return false;
+	}
+	return i == mKey.text.size();
+}
+
+int CVParagraph::layout(const CVTextView& text, const CVTextStyle& style) {
+	if (isCurrent(text, style))
+		return 0;
+
+	mLaidOut = false;
+	mRendered = false;
+	mKey.text.clear();
+	for (size_t pos = 0; pos < text.length(); )
+		mKey.text.push_back(text.next(pos));
+	mKey.maxWidth = mMaxWidth;
+	mKey.textSize = style.textSize();
+	mKey.stroke = style.strokeRadius();
+	mKey.font = mRenderer.fontName();
+	mKey.hinting = mRenderer.hinting();
+	mKey.renderMode = mRenderer.renderMode();
+	mKey.layout = mRenderer.layout();
+
+	std::map<BreakKey, std::vector<Line> >::const_iterator it = mBreaks.find(mKey);
+	if (it != mBreaks.end()) {
+		mLines = it->second;
+		mLaidOut = true;
+		return 0;
+	}
+
+	int error = mRenderer.measure(codePoints(mKey.text, 0, mKey.text.size()), style, mPlacements);
+	if (error != 0)
+		return error;
+
+	breakLines();
+
+	if (mBreaks.size() >= mMaxCached)
+		mBreaks.clear();
+	mBreaks[mKey] = mLines;
+	mLaidOut = true;
+	return 0;
+}
+
+void CVParagraph::breakLines() {
+	const std::vector<uint32_t>& text = mKey.text;
+	size_t n = text.size();
+	mLines.clear();
+
+	// x of the pen before character i, i == n included
+	std::vector<int> px(n + 1, 0);
+	for (size_t i = 0; i < n; i++)
+		px[i + 1] = mPlacements[i].x + mPlacements[i].width;
+
+	size_t begin = 0;
+	for (;;) {
+		// greedy: take characters while they fit, remembering the last
+		// place the line could have ended
+		size_t lastBreak = begin;
+		size_t i = begin;
+		for (; i < n && text[i] != '\n'; i++) {
+			if (i > begin && ((isSpace(text[i - 1]) && !isSpace(text[i])) || isIdeograph(text[i - 1]) || isIdeograph(text[i])))
+				lastBreak = i;
+			// spaces may hang over the edge, they are trimmed below
+			if (mMaxWidth > 0 && i > begin && !isSpace(text[i]) && px[i + 1] - px[begin] > mMaxWidth)
+				break;
+		}
+
+		bool wrapped = i < n && text[i] != '\n';
+		size_t end = i;
+		size_t next = i + 1;
+		if (wrapped) {
+			// a word longer than the line is cut where it overflows
+			end = lastBreak > begin ? lastBreak : i;
+			next = end;
+		}
+
+		size_t last = end;
+		while (last > begin && isSpace(text[last - 1]))
+			last--;
+
+		Line line;
+		line.begin = begin;
+		line.end = last;
+		line.width = px[last] - px[begin];
+		mLines.push_back(line);
+
+		if (next > n)
+			break;
+
+		// a wrapped line does not carry its break spaces to the next one
+		if (wrapped) {
+			while (next < n && isSpace(text[next]))
+				next++;
+		}
+		begin = next;
+		// no empty line after a trailing newline either
+		if (begin == n)
+			break;
+	}
+}
+
+int CVParagraph::renderBlock(const CVTextView& text, const CVTextStyle& style) {
+	int error = layout(text, style);
+	if (error != 0)
+		return error;
+	if (mRendered)
+		return 0;
+
+	cv::Mat& outline = mBlockOutline;
+	cv::Mat& fill = mBlockFill;
+
+	size_t n = mLines.size();
+	if (mLineOutlines.size() < n) {
+		mLineOutlines.resize(n);
+		mLineFills.resize(n);
+	}
+	mBaselines.assign(n, 0);
+
+	// glyphs are already cached by measure, so this only blits
+	int width = 0;
+	int ascent = 0;
+	int descent = 0;
+	for (size_t i = 0; i < n; i++) {
+		const Line& line = mLines[i];
+		if (line.begin == line.end) {
+			mLineFills[i].release();
+			continue;
+		}
+
+		error = mRenderer.renderCoverage(codePoints(mKey.text, line.begin, line.end), style, mLineOutlines[i], mLineFills[i], &mBaselines[i]);
+		if (error != 0)
+			return error;
+
+		width = std::max(width, mLineFills[i].cols);
+		ascent = std::max(ascent, mBaselines[i]);
+		descent = std::max(descent, mLineFills[i].rows - mBaselines[i]);
+	}
+
+	if (width == 0 || ascent + descent == 0) {
+		outline.release();
+		fill.release();
+		mRendered = true;
+		return 0;
+	}
+
+	// every line gets the same pitch, whatever glyphs it holds
+	int pitch = std::max(1, (int)((ascent + descent) * mLineSpacing + 0.5));
+	int height = ascent + descent + (int)(n - 1) * pitch;
+
+	outline.create(height, width, CV_8UC1);
+	outline.setTo(cv::Scalar::all(0));
+	fill.create(height, width, CV_8UC1);
+	fill.setTo(cv::Scalar::all(0));
+
+	for (size_t i = 0; i < n; i++) {
+		const cv::Mat& lineFill = mLineFills[i];
+		if (lineFill.empty())
+			continue;
+
+		int x = 0;
+		if (mAlign == CVRenderText::CENTER_MARGIN)
+			x = (width - lineFill.cols) / 2;
+		else if (mAlign == CVRenderText::RIGHT_MARGIN)
+			x = width - lineFill.cols;
+
+		// lines may overlap with a spacing below 1
+		cv::Rect rect(x, (int)i * pitch + ascent - mBaselines[i], lineFill.cols, lineFill.rows);
+		rect &= cv::Rect(0, 0, width, height);
+		cv::Rect src(0, 0, rect.width, rect.height);
+
+		cv::Mat dstOutline = outline(rect);
+		cv::max(dstOutline, mLineOutlines[i](src), dstOutline);
+		cv::Mat dstFill = fill(rect);
+		cv::max(dstFill, lineFill(src), dstFill);
+	}
+
+	mRendered = true;
+	return 0;
+}
+
+int CVParagraph::renderCoverage(const CVTextView& text, const CVTextStyle& style, cv::Mat& outline, cv::Mat& fill) {
+	int error = renderBlock(text, style);
+	if (error != 0)
+		return error;
+
+	mBlockOutline.copyTo(outline);
+	mBlockFill.copyTo(fill);
+	return 0;
+}
+
+int CVParagraph::renderText(cv::Mat& dstImg, cv::Point pos, const CVTextView& text, const CVTextStyle& style, 
+		CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, CVSaveUnder* saveUnder, 
+		CVDirtyRegion* dirty) {
+	int error = renderBlock(text, style);
+	if (error != 0)
+		return error;
+
+	// effects pad into their own buffers, the block stays as it is
+	if (!mBlockFill.empty())
+		cvEffectCoverage(style, mBlockOutline, mBlockFill, mEffects);
+	const cv::Mat& outline = mEffects.outline;
+	const cv::Mat& fill = mEffects.fill;
+
+	cv::Rect rect;
+	if (!mBlockFill.empty())
+		rect = CVRenderText::labelRect(fill.size(), pos, xMargin, yMargin, dstImg.size());
+	if (saveUnder)
+		saveUnder->save(dstImg, rect);
+	if (rect.area() == 0)
+		return 0;
+
+	cv::Rect rectText(0, 0, rect.width, rect.height);
+	cv::Mat blendImg(dstImg, rect);
+	cvBlendCoverage(style, outline(rectText), fill(rectText), blendImg, 
+		mEffects.shadow.empty() ? cv::Mat() : mEffects.shadow(rectText), mEffects.glow.empty() ? cv::Mat() : mEffects.glow(rectText));
+	if (dirty)
+		dirty->add(rect);
+	return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef CV_PARAGRAPH_H__
+#define CV_PARAGRAPH_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+#include "cvtextstyle.h"
+
+// Wraps text into lines no wider than a maximum width and draws them as one
+// block. Breaks are found from the cached glyph advances (no rasterization)
+// and remembered per text, width and style, so laying out the same caption
+// again only costs a lookup. The lines are stacked into a single coverage
+// image and blended onto the destination in one pass; drawing the current
+// caption again compares it in place and reuses that image.
+class CVParagraph
+{
+public:
+	// one line of the paragraph, as a range of code points of the text
+	struct Line {
+		size_t begin;
+		size_t end;		// exclusive, trailing spaces and the newline excluded
+		int width;
+	};
+
+protected:
+	struct BreakKey {
+		std::vector<uint32_t> text;
+		int maxWidth;
+		size_t textSize;
+		long stroke;
+		std::string font;
+		// renderer settings that change the advances
+		CVRenderText::Hinting hinting;
+		CVRenderText::RenderMode renderMode;
+		CVRenderText::Layout layout;
+
+		bool operator<(const BreakKey& other) const;
+	};
+
+	CVRenderText& mRenderer;
+	int mMaxWidth;
+	double mLineSpacing;
+	CVRenderText::Justify mAlign;
+
+	// break cache, flushed when it grows past mMaxCached entries
+	std::map<BreakKey, std::vector<Line> > mBreaks;
+	size_t mMaxCached;
+
+	// current paragraph; mRendered when mBlockOutline/mBlockFill hold it
+	BreakKey mKey;
+	bool mLaidOut;
+	bool mRendered;
+	std::vector<Line> mLines;
+	std::vector<CVRenderText::Placement> mPlacements;
+	cv::Mat mBlockOutline;
+	cv::Mat mBlockFill;
+
+	// coverage scratch
+	std::vector<cv::Mat> mLineOutlines;
+	std::vector<cv::Mat> mLineFills;
+	std::vector<int> mBaselines;
+	CVEffectBuffers mEffects;
+
+	// whether text and style lay out as the current paragraph, without
+	// copying the text
+	bool isCurrent(const CVTextView& text, const CVTextStyle& style) const;
+	void breakLines();
+	// layout, then stack the lines into mBlockOutline/mBlockFill unless
+	// they already hold them
+	int renderBlock(const CVTextView& text, const CVTextStyle& style);
+
+private:
+	CVParagraph(const CVParagraph&);
+	CVParagraph& operator=(const CVParagraph&);
+
+public:
+	explicit CVParagraph(CVRenderText& renderer);
+
+	// lines wider than this are wrapped; 0 or less only breaks at '\n'
+	void setMaxWidth(int width) { mMaxWidth = width; }
+	// distance between baselines as a multiple of the line height
+	void setLineSpacing(double spacing) { mLineSpacing = spacing; mRendered = false; }
+	// LEFT_MARGIN, CENTER_MARGIN or RIGHT_MARGIN within the block
+	void setAlign(CVRenderText::Justify align) { mAlign = align; mRendered = false; }
+	void setMaxCached(size_t entries) { mMaxCached = entries; }
+
+	// break text into lines; returns the renderer's error code
+	int layout(const CVTextView& text, const CVTextStyle& style);
+
+	// layout, then render the block into CV_8UC1 coverage like renderCoverage
+	int renderCoverage(const CVTextView& text, const CVTextStyle& style, cv::Mat& outline, cv::Mat& fill);
+
+	// layout and blend the block, positioned like renderText; with
+	// saveUnder, the pixels under it are saved first, and the modified
+	// rectangle is added to dirty
+	int renderText(cv::Mat& dstImg, cv::Point pos, const CVTextView& text, const CVTextStyle& style, 
+		CVRenderText::Justify xMargin = CVRenderText::CENTER_MARGIN, CVRenderText::Justify yMargin = CVRenderText::CENTER_MARGIN, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
+
+	const std::vector<Line>& lines() const { return mLines; }
+	size_t cachedLayouts() const { return mBreaks.size(); }
+	void clearCache() { mBreaks.clear(); }
+};
+
+#endif//CV_PARAGRAPH_H__
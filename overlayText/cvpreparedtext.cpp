@@ -0,0 +1,42 @@
+#include "cvpreparedtext.h"
+
+CVPreparedText::CVPreparedText()
+	: mBaseline(0) {
+}
+
+int CVPreparedText::create(CVRenderText& renderer, const CVTextView& text, const CVTextStyle& style) {
+	int error = renderer.renderCoverage(text, style, mOutline, mFill, &mBaseline, &mPlacements);
+	if (error != 0) {
+		release();
+		return error;
+	}
+
+	mSprite.compose(mOutline, mFill, style);
+	mSprite.baseline = mBaseline + mSprite.origin.y;
+	return 0;
+}
+
+int CVPreparedText::create(CVRenderText& renderer, const CVTextView& text, size_t textSize, cv::Scalar textColor, 
+		bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) {
+	return create(renderer, text, CVTextStyle(textSize, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity));
+}
+
+int CVPreparedText::create(CVRenderText& renderer, const wchar_t* text, size_t textSize, cv::Scalar textColor, 
+		bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) {
+	return create(renderer, CVTextView::wide(text), textSize, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity);
+}
+
+cv::Rect CVPreparedText::draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, double alpha, 
+		CVSaveUnder* saveUnder) const {
+	if (mSprite.empty())
+		return cv::Rect();
+	return mSprite.draw(dstImg, pos, xMargin, yMargin, alpha, saveUnder);
+}
+
+void CVPreparedText::release() {
+	mPlacements.clear();
+	mOutline.release();
+	mFill.release();
+	mSprite.release();
+	mBaseline = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef CV_PREPARED_TEXT_H__
+#define CV_PREPARED_TEXT_H__
+
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+#include "cvtextsprite.h"
+
+// A label laid out and rasterized once, then drawn at any position as many
+// times as needed (a tracked object's name, for instance). draw only works
+// out the justification offset and blends the composited sprite.
+class CVPreparedText
+{
+protected:
+	std::vector<CVRenderText::Placement> mPlacements;
+	cv::Mat mOutline;
+	cv::Mat mFill;
+	int mBaseline;
+	CVTextSprite mSprite;
+
+public:
+	CVPreparedText();
+
+	// same arguments as renderText; returns the renderer's error code
+	int create(CVRenderText& renderer, const CVTextView& text, const CVTextStyle& style);
+	int create(CVRenderText& renderer, const CVTextView& text, size_t textSize, cv::Scalar textColor = cv::Scalar::all(255), 
+		bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, 
+		cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+	int create(CVRenderText& renderer, const wchar_t* text, size_t textSize, cv::Scalar textColor = cv::Scalar::all(255), 
+		bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, 
+		cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+
+	// blend at pos, positioned like renderText and faded by alpha, saving
+	// the pixels under it with saveUnder; returns the modified rectangle
+	cv::Rect draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin = CVRenderText::CENTER_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::CENTER_MARGIN, double alpha = 1.0, CVSaveUnder* saveUnder = NULL) const;
+
+	bool empty() const { return mSprite.empty(); }
+	cv::Size size() const { return mSprite.size(); }
+	int baseline() const { return mBaseline; }
+	const std::vector<CVRenderText::Placement>& placements() const { return mPlacements; }
+	const cv::Mat& outlineCoverage() const { return mOutline; }
+	const cv::Mat& fillCoverage() const { return mFill; }
+	const CVTextSprite& sprite() const { return mSprite; }
+	void release();
+};
+
+#endif//CV_PREPARED_TEXT_H__
@@ -1,20 +1,202 @@
 #include "cvrendertext.h"
+#include "cvcompositor.h"
 #include <cwchar>
 #include <stdint.h>
 #include <vector>
 
 #include FT_GLYPH_H
 
+#include <opencv2/imgproc/imgproc.hpp>
+
 #ifdef _MSC_VER
 #pragma warning(disable:4996)
 #endif
 
+// copy a cached glyph bitmap into the text coverage image, pen at x
+static void blitGlyph(const CVGlyph& glyph, int x, long top, cv::Mat& gray) {
+	int left = x + glyph.left;
+	if (left < 0)
+		left = 0;
+
+	int width = glyph.monoWidth ? glyph.monoWidth : glyph.bitmap.cols;
+	cv::Rect rect(left, (int)(top - glyph.top), width, glyph.bitmap.rows);
+	cv::Rect clipped = rect & cv::Rect(0, 0, gray.cols, gray.rows);
+	if (clipped.area() <= 0)
+		return;
+
+	if (!glyph.monoWidth) {
+		glyph.bitmap(cv::Rect(clipped.x - rect.x, clipped.y - rect.y, clipped.width, clipped.height)).copyTo(gray(clipped));
+		return;
+	}
+
+	// mono glyphs expand to full coverage
+	for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+		const uchar* src = glyph.bitmap.ptr<uchar>(y - rect.y);
+		uchar* dst = gray.ptr<uchar>(y);
+		for (int px = clipped.x; px < clipped.x + clipped.width; px++) {
+			int bit = px - rect.x;
+			dst[px] = (src[bit >> 3] & (0x80 >> (bit & 7))) ? 255 : 0;
+		}
+	}
+}
+
+// OR a mono glyph into a packed label mask of width pixels, pen at x
+static void blitMono(const CVGlyph& glyph, int x, long top, int width, cv::Mat& mask) {
+	int left = x + glyph.left;
+	if (left < 0)
+		left = 0;
+
+	int shift = left & 7;
+	int first = left >> 3;
+	int bytes = (std::min(glyph.monoWidth, width - left) + 7) >> 3;
+	if (bytes <= 0)
+		return;
+
+	for (int row = 0; row < glyph.bitmap.rows; row++) {
+		int y = (int)(top - glyph.top) + row;
+		if (y < 0 || y >= mask.rows)
+			continue;
+
+		const uchar* src = glyph.bitmap.ptr<uchar>(row);
+		uchar* dst = mask.ptr<uchar>(y) + first;
+		// the mask has a spare byte a row for the bits shifted out
+		for (int i = 0; i < bytes; i++) {
+			dst[i] |= (uchar)(src[i] >> shift);
+			if (shift)
+				dst[i + 1] |= (uchar)(src[i] << (8 - shift));
+		}
+	}
+}
+
+// 8-bit coverage of a FreeType bitmap: mono and 2/4 bit grays of bitmap
+// fonts are expanded, colour strikes give their alpha
+static void toCoverage(const FT_Bitmap& bitmap, cv::Mat& coverage) {
+	int width = (int)bitmap.width;
+	int rows = (int)bitmap.rows;
+	coverage.create(rows, width, CV_8UC1);
+
+	for (int y = 0; y < rows; y++) {
+		const unsigned char* src = bitmap.buffer + y * bitmap.pitch;
+		uchar* dst = coverage.ptr<uchar>(y);
+
+		switch (bitmap.pixel_mode) {
+		case FT_PIXEL_MODE_MONO:
+			for (int x = 0; x < width; x++)
+				dst[x] = (src[x >> 3] & (0x80 >> (x & 7))) ? 255 : 0;
+			break;
+		case FT_PIXEL_MODE_GRAY2:
+			for (int x = 0; x < width; x++)
+				dst[x] = (uchar)(((src[x >> 2] >> (6 - 2 * (x & 3))) & 3) * 85);
+			break;
+		case FT_PIXEL_MODE_GRAY4:
+			for (int x = 0; x < width; x++)
+				dst[x] = (uchar)(((src[x >> 1] >> (4 - 4 * (x & 1))) & 15) * 17);
+			break;
+		case FT_PIXEL_MODE_BGRA:
+			for (int x = 0; x < width; x++)
+				dst[x] = src[4 * x + 3];
+			break;
+		case FT_PIXEL_MODE_GRAY:
+			if (bitmap.num_grays == 256 || bitmap.num_grays < 2) {
+				memcpy(dst, src, width);
+			} else {
+				int maxGray = bitmap.num_grays - 1;
+				for (int x = 0; x < width; x++)
+					dst[x] = (uchar)(std::min((int)src[x], maxGray) * 255 / maxGray);
+			}
+			break;
+		default:
+			memset(dst, 0, width);
+			break;
+		}
+	}
+}
+
+// 1-bpp rows, leftmost pixel in the most significant bit, from coverage
+// thresholded at half
+static void packMono(const cv::Mat& coverage, CVGlyph& entry) {
+	int width = coverage.cols;
+	int bytes = (width + 7) >> 3;
+
+	entry.monoWidth = width;
+	entry.bitmap.create(coverage.rows, bytes, CV_8UC1);
+	entry.bitmap.setTo(cv::Scalar::all(0));
+
+	for (int y = 0; y < coverage.rows; y++) {
+		const uchar* src = coverage.ptr<uchar>(y);
+		uchar* dst = entry.bitmap.ptr<uchar>(y);
+		for (int x = 0; x < width; x++) {
+			if (src[x] >= 128)
+				dst[x >> 3] |= (uchar)(0x80 >> (x & 7));
+		}
+	}
+}
+
+// strike of a bitmap font closest to textSize pixels
+static int nearestStrike(FT_Face face, size_t textSize) {
+	int best = 0;
+	long bestDiff = -1;
+	for (int i = 0; i < face->num_fixed_sizes; i++) {
+		const FT_Bitmap_Size& strike = face->available_sizes[i];
+		long size = strike.y_ppem ? (strike.y_ppem + 32) >> 6 : strike.height;
+		long diff = std::abs(size - (long)textSize);
+		if (bestDiff < 0 || diff < bestDiff) {
+			best = i;
+			bestDiff = diff;
+		}
+	}
+	return best;
+}
+
 CVRenderText::CVRenderText()
 	: mLibrary(NULL)
 	, mStroker(NULL)
 	, mFace(NULL)
 	, mInitialized(false)
-	, mFontName("") {
+	, mFontName("")
+	, mCache(std::make_shared<CVGlyphCache>())
+	, mReaderId(-1)
+	, mFaceId(0)
+	, mFaceSize(0)
+	, mStrokerSize(0)
+	, mRunWidth(0)
+	, mRunTop(0)
+	, mRunBottom(0)
+	, mRunFixedExtent(false)
+	, mBusyJobs(0)
+	, mStopWorker(false)
+	, mLayout(TIGHT_LAYOUT)
+	, mRenderMode(ANTIALIASED_RENDER)
+	, mHinting(FULL_HINTING) {
+	initLibrary();
+}
+
+CVRenderText::CVRenderText(const std::shared_ptr<CVGlyphCache>& cache)
+	: mLibrary(NULL)
+	, mStroker(NULL)
+	, mFace(NULL)
+	, mInitialized(false)
+	, mFontName("")
+	, mCache(cache ? cache : std::make_shared<CVGlyphCache>())
+	, mReaderId(-1)
+	, mFaceId(0)
+	, mFaceSize(0)
+	, mStrokerSize(0)
+	, mRunWidth(0)
+	, mRunTop(0)
+	, mRunBottom(0)
+	, mRunFixedExtent(false)
+	, mBusyJobs(0)
+	, mStopWorker(false)
+	, mLayout(TIGHT_LAYOUT)
+	, mRenderMode(ANTIALIASED_RENDER)
+	, mHinting(FULL_HINTING) {
+	initLibrary();
+}
+
+void CVRenderText::initLibrary() {
+	mReaderId = mCache->registerReader();
+
 	FT_Error error;
 	error = FT_Init_FreeType(&mLibrary);
 
@@ -34,6 +216,17 @@ CVRenderText::CVRenderText()
 }
 
 CVRenderText::~CVRenderText() {
+	if (mWorker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mJobMutex);
+			mStopWorker = true;
+		}
+		mJobCond.notify_all();
+		mWorker.join();
+	}
+
+	mCache->unregisterReader(mReaderId);
+
 	if (mFace) {
 		FT_Done_Face(mFace);
 		mFace = NULL;
@@ -53,8 +246,10 @@ CVRenderText::~CVRenderText() {
 int CVRenderText::setFont(const char* path_to_font) {
 	FT_Error error;
 	mFontName = path_to_font;
+	mFaceSize = 0;
 
 	if (mFace) {
+		mCharMap.reset(NULL);
 		FT_Done_Face(mFace);
 		mFace = NULL;
 	}
@@ -70,154 +265,618 @@ int CVRenderText::setFont(const char* path_to_font) {
 			mLibrary = NULL;
 			return error;
 		}
+		mStrokerSize = 0;
 	}
 
-	return FT_New_Face(mLibrary, path_to_font, 0, &mFace);
+	error = FT_New_Face(mLibrary, path_to_font, 0, &mFace);
+	if (error != 0)
+		return error;
+
+	mCharMap.reset(mFace);
+	mFaceId = mCache->faceId(mFontName);
+	return 0;
 }
 
-int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const wchar_t* text, size_t textSize, Justify xMargin, Justify yMargin, 
-		cv::Scalar textColor, bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity)
-{
+void CVRenderText::setGlyphCache(const std::shared_ptr<CVGlyphCache>& cache) {
+	std::lock_guard<std::mutex> lock(mJobMutex);
+	mCache->unregisterReader(mReaderId);
+	mCache = cache ? cache : std::make_shared<CVGlyphCache>();
+	mReaderId = mCache->registerReader();
+	if (mFace)
+		mFaceId = mCache->faceId(mFontName);
+}
+
+int CVRenderText::selectSize(size_t textSize) {
+	if (mFaceSize == textSize)
+		return 0;
+
+	// bitmap fonts only come in their strikes
 	FT_Error error;
+	if (!FT_IS_SCALABLE(mFace) && FT_HAS_FIXED_SIZES(mFace))
+		error = FT_Select_Size(mFace, nearestStrike(mFace, textSize));
+	else
+		error = FT_Set_Char_Size(mFace, 0, textSize * 64, 0, 0);
+	if (error != 0)
+		return error;
 
-	if (!mFace)
-		return -1;
+	mFaceSize = textSize;
+	return 0;
+}
+
+int CVRenderText::loadGlyph(FT_UInt glyph_index, size_t textSize, size_t stroke, const CVGlyph*& glyph) {
+	bool mono = mRenderMode == MONO_RENDER;
+	CVGlyphKey key(mFaceId, (uint32_t)textSize, glyph_index, (uint32_t)stroke, mono ? CVGlyphKey::MONO : CVGlyphKey::ANTIALIASED, 
+		(uint32_t)mHinting);
 
-	error = FT_Set_Char_Size(mFace, 0, textSize * 64, 0, 0);
+	glyph = mCache->find(key);
+	if (glyph)
+		return 0;
+
+	// cache miss: rasterize with this renderer's own face
+	FT_Error error = selectSize(textSize);
 	if (error != 0)
 		return error;
 
-	if (hasBorder && mStroker)
-		FT_Stroker_Set(mStroker, brdSize * 64, FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0);
+	if (stroke && mStrokerSize != stroke) {
+		if (!mStroker)
+			return -1;
+		FT_Stroker_Set(mStroker, stroke * 64, FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0);
+		mStrokerSize = stroke;
+	}
 
-	// Get total width
-	unsigned int total_width = 0;
-	long max_top = 0;
-	long min_bottom = 0;
-	unsigned int max_height = 0;
-
-	for (int i = 0; i < std::wcslen(text); i++) {
-		FT_UInt glyph_index = FT_Get_Char_Index(mFace, text[i]);
-		FT_BBox  bbox;
-		FT_Glyph glyph;
-		// Have to use FT_LOAD_RENDER.
-		// If use FT_LOAD_DEFAULT, the actual glyph bitmap won't be loaded,
-		// thus bitmap->rows will be incorrect, causing insufficient max_height.
-		error = FT_Load_Glyph(mFace, glyph_index, FT_LOAD_DEFAULT);
-		if (error != 0) {
-			return error;
+	// embedded strikes are taken when the face has one at this size; mono
+	// keeps its own hinting target under LIGHT_HINTING
+	FT_Int32 loadFlags = mono ? FT_LOAD_TARGET_MONO : FT_LOAD_DEFAULT;
+	if (mHinting == FAST_HINTING)
+		loadFlags |= FT_LOAD_NO_HINTING;
+	else if (mHinting == LIGHT_HINTING && !mono)
+		loadFlags = FT_LOAD_TARGET_LIGHT;
+	error = FT_Load_Glyph(mFace, glyph_index, loadFlags);
+	if (error != 0)
+		return error;
+
+	CVGlyph entry;
+	FT_GlyphSlot slot = mFace->glyph;
+	if (slot->format == FT_GLYPH_FORMAT_BITMAP) {
+		// bitmap font or embedded strike: nothing to rasterize, the border
+		// is grown from the bitmap since there is no outline to stroke
+		cv::Mat coverage;
+		toCoverage(slot->bitmap, coverage);
+		entry.left = slot->bitmap_left;
+		entry.top = slot->bitmap_top;
+		entry.bottom = slot->bitmap_top - coverage.rows;
+		entry.right = slot->bitmap_left + coverage.cols;
+		entry.advance = slot->advance.x >> 6;
+
+		if (stroke && !coverage.empty()) {
+			int r = (int)stroke;
+			cv::Mat padded;
+			cv::copyMakeBorder(coverage, padded, r, r, r, r, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+			cv::dilate(padded, coverage, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * r + 1, 2 * r + 1)));
+			entry.left -= r;
+			entry.top += r;
+			entry.bottom -= r;
+			entry.right += r;
 		}
 
-		error = FT_Get_Glyph(mFace->glyph, &glyph);
-		if (error != 0) {
+		if (mono)
+			packMono(coverage, entry);
+		else
+			entry.bitmap = coverage;
+
+		glyph = mCache->insert(key, entry);
+		return 0;
+	}
+
+	FT_Glyph ftGlyph;
+	error = FT_Get_Glyph(mFace->glyph, &ftGlyph);
+	if (error != 0)
+		return error;
+
+	if (stroke)
+		FT_Glyph_StrokeBorder(&ftGlyph, mStroker, false, true);
+
+	FT_Glyph_To_Bitmap(&ftGlyph, mono ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL, nullptr, true);
+
+	FT_BBox bbox;
+	FT_Glyph_Get_CBox(ftGlyph, FT_GLYPH_BBOX_TRUNCATE, &bbox);
+	FT_BitmapGlyph bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(ftGlyph);
+
+	if (mono) {
+		cv::Mat coverage;
+		toCoverage(bitmapGlyph->bitmap, coverage);
+		packMono(coverage, entry);
+	} else {
+		cv::Mat(bitmapGlyph->bitmap.rows, bitmapGlyph->bitmap.width, CV_8UC1, bitmapGlyph->bitmap.buffer, bitmapGlyph->bitmap.pitch).copyTo(entry.bitmap);
+	}
+	entry.left = bitmapGlyph->left;
+	entry.top = bbox.yMax;
+	entry.bottom = bbox.yMin;
+	entry.right = bbox.xMax;
+	entry.advance = mFace->glyph->advance.x >> 6;
+	FT_Done_Glyph(ftGlyph);
+
+	glyph = mCache->insert(key, entry);
+	return 0;
+}
+
+bool CVRenderText::faceExtent(size_t textSize, bool hasBorder, size_t brdSize, long& top, long& bottom) {
+	long stroke = hasBorder ? (long)brdSize : 0;
+	if (FT_IS_SCALABLE(mFace) && mFace->units_per_EM) {
+		// face metrics scaled by hand, FT_Set_Char_Size is only needed on a cache miss
+		long em = mFace->units_per_EM;
+		long ascender = (mFace->ascender * (long)textSize + em - 1) / em;
+		long descender = (-mFace->descender * (long)textSize + em - 1) / em;
+
+		top = ascender + stroke + 1;
+		bottom = -(descender + stroke) - 1;
+		return true;
+	}
+
+	if (selectSize(textSize) == 0) {
+		// BDF/PCF/FNT drivers report the strike's ascent and descent here
+		long ascender = mFace->size->metrics.ascender >> 6;
+		long descender = -mFace->size->metrics.descender >> 6;
+
+		top = ascender + stroke + 1;
+		bottom = -(descender + stroke) - 1;
+		return true;
+	}
+	return false;
+}
+
+int CVRenderText::addRunGlyph(uint32_t codepoint, size_t textSize, bool hasBorder, size_t brdSize) {
+	FT_UInt glyph_index = mCharMap.glyphIndex(codepoint);
+	RunGlyph rg;
+	rg.codepoint = codepoint;
+	rg.glyph_index = glyph_index;
+
+	int error = loadGlyph(glyph_index, textSize, 0, rg.fill);
+	if (error != 0)
+		return error;
+
+	rg.border = NULL;
+	if (hasBorder) {
+		error = loadGlyph(glyph_index, textSize, brdSize, rg.border);
+		if (error != 0)
 			return error;
+	}
+
+	mRun.push_back(rg);
+
+	// the border glyph is the larger one when present
+	const CVGlyph& outer = hasBorder ? *rg.border : *rg.fill;
+	mRunWidth += std::max(outer.right, outer.advance);
+	if (hasBorder)
+		mRunWidth += brdSize;
+
+	if (!mRunFixedExtent) {
+		mRunTop = std::max(mRunTop, (long)outer.top + 1);
+		mRunBottom = std::min(mRunBottom, (long)outer.bottom - 1);
+	}
+	return 0;
+}
+
+int CVRenderText::layoutRun(const CVTextView& text, size_t textSize, bool hasBorder, size_t brdSize) {
+	// mRun keeps its capacity, so this does not allocate once warmed up
+	mRun.clear();
+	mRunWidth = 0;
+	mRunTop = 0;
+	mRunBottom = 0;
+	// the baseline layout knows its rows before the first glyph, so the
+	// run only has to sum advances
+	mRunFixedExtent = mLayout == BASELINE_LAYOUT && faceExtent(textSize, hasBorder, brdSize, mRunTop, mRunBottom);
+
+	size_t pos = 0;
+	while (pos < text.length()) {
+		// plain ASCII needs no decoding
+		size_t end = pos + text.asciiRunAt(pos);
+		for (; pos < end; pos++) {
+			int error = addRunGlyph(text.unitAt(pos), textSize, hasBorder, brdSize);
+			if (error != 0)
+				return error;
 		}
 
-		if (hasBorder) {
-			FT_Glyph_StrokeBorder(&glyph, mStroker, false, true);
+		if (pos < text.length()) {
+			int error = addRunGlyph(text.next(pos), textSize, hasBorder, brdSize);
+			if (error != 0)
+				return error;
 		}
+	}
 
-		FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, nullptr, true);
-		FT_Glyph_Get_CBox( glyph, FT_GLYPH_BBOX_TRUNCATE, &bbox );
-		FT_BitmapGlyph bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(glyph);
-		
-		total_width += std::max(bbox.xMax, mFace->glyph->advance.x >> 6);
-		if (hasBorder)
-			total_width += brdSize;
+	return 0;
+}
 
-		max_top = std::max(max_top, bbox.yMax + 1);
-		min_bottom = std::min(min_bottom, bbox.yMin - 1);
-		FT_Done_Glyph(glyph);
+int CVRenderText::cacheGlyphs(const CVTextView& text, size_t textSize, bool hasBorder, size_t brdSize) {
+	if (!mFace)
+		return -1;
+
+	CVGlyphCache::ReadGuard guard(*mCache, mReaderId);
+	return layoutRun(text, textSize, hasBorder, brdSize);
+}
+
+int CVRenderText::cacheGlyphs(const wchar_t* text, size_t textSize, bool hasBorder, size_t brdSize) {
+	return cacheGlyphs(CVTextView::wide(text), textSize, hasBorder, brdSize);
+}
+
+int CVRenderText::queueJob(PrepareJob& job) {
+	if (!mFace)
+		return -1;
+
+	job.font = mFontName;
+	job.mono = mRenderMode == MONO_RENDER;
+	job.hinting = mHinting;
+
+	std::lock_guard<std::mutex> lock(mJobMutex);
+	if (!mWorker.joinable())
+		mWorker = std::thread(&CVRenderText::workerLoop, this);
+
+	mJobs.push_back(PrepareJob());
+	std::swap(mJobs.back(), job);
+	mJobCond.notify_one();
+	return 0;
+}
+
+int CVRenderText::prepare(const CVTextView& text, size_t textSize, bool hasBorder, size_t brdSize) {
+	PrepareJob job;
+	job.text.reserve(text.length());
+	for (size_t pos = 0; pos < text.length(); )
+		job.text.push_back(text.next(pos));
+	job.sizes.push_back(textSize);
+	job.hasBorder = hasBorder;
+	job.brdSize = brdSize;
+	return queueJob(job);
+}
+
+int CVRenderText::prepare(const wchar_t* text, size_t textSize, bool hasBorder, size_t brdSize) {
+	return prepare(CVTextView::wide(text), textSize, hasBorder, brdSize);
+}
+
+int CVRenderText::prepare(const char* text, size_t textSize, bool hasBorder, size_t brdSize) {
+	return prepare(CVTextView::utf8(text), textSize, hasBorder, brdSize);
+}
+
+int CVRenderText::prepare(const CVTextView& text, const CVTextStyle& style) {
+	return prepare(text, style.textSize(), style.hasBorder(), style.brdSize());
+}
+
+int CVRenderText::warmup(const wchar_t* charset, const std::vector<size_t>& sizes, bool hasBorder, size_t brdSize) {
+	CVTextView text = CVTextView::wide(charset);
+
+	PrepareJob job;
+	for (size_t pos = 0; pos < text.length(); )
+		job.text.push_back(text.next(pos));
+	job.sizes = sizes;
+	job.hasBorder = hasBorder;
+	job.brdSize = brdSize;
+	return queueJob(job);
+}
+
+void CVRenderText::waitPrepared() {
+	std::unique_lock<std::mutex> lock(mJobMutex);
+	while (!mJobs.empty() || mBusyJobs > 0)
+		mJobCond.wait(lock);
+}
+
+void CVRenderText::workerLoop() {
+	// FreeType faces are not thread safe, so the worker rasterizes through
+	// its own renderer that writes into the same glyph cache; setGlyphCache
+	// swaps mCache under the job mutex
+	std::shared_ptr<CVGlyphCache> cache;
+	{
+		std::lock_guard<std::mutex> lock(mJobMutex);
+		cache = mCache;
 	}
+	CVRenderText worker(cache);
+
+	for (;;) {
+		PrepareJob job;
+		{
+			std::unique_lock<std::mutex> lock(mJobMutex);
+			while (mJobs.empty() && !mStopWorker)
+				mJobCond.wait(lock);
+			if (mStopWorker)
+				break;
+
+			std::swap(job, mJobs.front());
+			mJobs.pop_front();
+			mBusyJobs++;
+		}
+
+		// the owner may have switched caches since the worker started
+		{
+			std::lock_guard<std::mutex> lock(mJobMutex);
+			cache = mCache;
+		}
+		if (worker.glyphCache() != cache)
+			worker.setGlyphCache(cache);
+
+		if (worker.mFontName != job.font || !worker.mFace)
+			worker.setFont(job.font.c_str());
+		worker.setRenderMode(job.mono ? MONO_RENDER : ANTIALIASED_RENDER);
+		worker.setHinting((Hinting)job.hinting);
 
-	max_height = (unsigned int)(max_top - min_bottom);
+		CVTextView text = job.text.empty() ? CVTextView() : CVTextView(&job.text[0], job.text.size());
+		for (size_t i = 0; i < job.sizes.size(); i++)
+			worker.cacheGlyphs(text, job.sizes[i], job.hasBorder, job.brdSize);
+
+		{
+			std::lock_guard<std::mutex> lock(mJobMutex);
+			mBusyJobs--;
+		}
+		mJobCond.notify_all();
+	}
+}
+
+int CVRenderText::renderCoverage(const CVTextView& text, size_t textSize, bool hasBorder, size_t brdSize, cv::Mat& outline, cv::Mat& fill, int* baseline, 
+		std::vector<Placement>* placements) {
+	int error;
+
+	if (!mFace)
+		return -1;
+
+	CVGlyphCache::ReadGuard guard(*mCache, mReaderId);
+	error = layoutRun(text, textSize, hasBorder, brdSize);
+	if (error != 0)
+		return error;
+
+	// Get total width
+	unsigned int total_width = mRunWidth;
+	long max_top = mRunTop;
+	long min_bottom = mRunBottom;
+	unsigned int max_height = (unsigned int)(max_top - min_bottom);
+
+	// Copy grayscale image from the cached glyphs to OpenCV
+	outline.create(max_height, total_width, CV_8UC1);
+	outline.setTo(cv::Scalar::all(0));
+	fill.create(max_height, total_width, CV_8UC1);
+	fill.setTo(cv::Scalar::all(0));
+
+	if (placements)
+		placements->resize(mRun.size());
 
-	// Copy grayscale image from FreeType to OpenCV
-	cv::Mat gray_outline(max_height, total_width, CV_8UC1, cv::Scalar::all(0));
-	cv::Mat gray_text(max_height, total_width, CV_8UC1, cv::Scalar::all(0));
 	int x = 0;
-	for (int i = 0; i < std::wcslen(text); i++) {
-		FT_UInt glyph_index = FT_Get_Char_Index(mFace, text[i]);
-		FT_BBox  bbox;
-		FT_Glyph glyph;
+	for (size_t i = 0; i < mRun.size(); i++) {
+		const RunGlyph& rg = mRun[i];
+		int width;
 
-		error = FT_Load_Glyph(mFace, glyph_index, FT_LOAD_DEFAULT);
-		if (error != 0) {
-			return error;
+		if (hasBorder) {
+			blitGlyph(*rg.border, x, max_top, outline);
+			blitGlyph(*rg.fill, x, max_top, fill);
+
+			width = std::max(rg.border->right, rg.border->advance) + (int)brdSize;
+		} else {
+			blitGlyph(*rg.fill, x, max_top, fill);
+
+			width = std::max(rg.fill->right, rg.fill->advance);
 		}
 
-		error = FT_Get_Glyph(mFace->glyph, &glyph);
-		if (error != 0) {
-			return error;
+		if (placements) {
+			Placement& p = (*placements)[i];
+			p.codepoint = rg.codepoint;
+			p.glyph_index = rg.glyph_index;
+			p.x = x;
+			p.width = width;
 		}
+		x += width;
+	}
 
-		if (hasBorder) {
-			// create outline
-			FT_Glyph_StrokeBorder(&glyph, mStroker, false, true);
-			FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, nullptr, true);
-			FT_Glyph_Get_CBox( glyph, FT_GLYPH_BBOX_TRUNCATE, &bbox );
-
-			FT_BitmapGlyph bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(glyph);
-			cv::Mat glyph_img(bitmapGlyph->bitmap.rows, bitmapGlyph->bitmap.width, CV_8UC1, bitmapGlyph->bitmap.buffer, bitmapGlyph->bitmap.pitch);
-			int top = max_top - bbox.yMax;
-
-			int left = x + bitmapGlyph->left;
-			if (left < 0)
-				left = 0;
-			cv::Rect rect(left, top, bitmapGlyph->bitmap.width, bitmapGlyph->bitmap.rows);
-
-			cv::Mat gray_part(gray_outline, rect);
-			glyph_img.copyTo(gray_part);
-
-			int max_x = std::max(bbox.xMax, mFace->glyph->advance.x >> 6);
-			
-			FT_Done_Glyph(glyph);
-			//create text
-			error = FT_Get_Glyph(mFace->glyph, &glyph);
-			if (error != 0) {
-				return error;
-			}
+	if (baseline)
+		*baseline = (int)max_top;
 
-			FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, nullptr, true);
-			FT_Glyph_Get_CBox( glyph, FT_GLYPH_BBOX_TRUNCATE, &bbox );
+	return 0;
+}
 
-			bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(glyph);
-			glyph_img = cv::Mat(bitmapGlyph->bitmap.rows, bitmapGlyph->bitmap.width, CV_8UC1, bitmapGlyph->bitmap.buffer, bitmapGlyph->bitmap.pitch);
-			top = max_top - bbox.yMax;
+int CVRenderText::renderCoverage(const wchar_t* text, size_t textSize, bool hasBorder, size_t brdSize, cv::Mat& outline, cv::Mat& fill, int* baseline) {
+	return renderCoverage(CVTextView::wide(text), textSize, hasBorder, brdSize, outline, fill, baseline);
+}
 
-			left = x + bitmapGlyph->left;
-			if (left < 0)
-				left = 0;
-			rect = cv::Rect(left, top, bitmapGlyph->bitmap.width, bitmapGlyph->bitmap.rows);
+int CVRenderText::renderCoverage(const CVTextView& text, const CVTextStyle& style, cv::Mat& outline, cv::Mat& fill, int* baseline, 
+		std::vector<Placement>* placements) {
+	return renderCoverage(text, style.textSize(), style.hasBorder(), style.brdSize(), outline, fill, baseline, placements);
+}
 
-			gray_part = cv::Mat(gray_text, rect);
-			glyph_img.copyTo(gray_part);
+int CVRenderText::renderMask(const CVTextView& text, const CVTextStyle& style, cv::Mat& outline, cv::Mat& fill, int& width, int* baseline) {
+	if (!mFace)
+		return -1;
 
-			x += max_x;
-			if (hasBorder)
-				x += brdSize;
-			FT_Done_Glyph(glyph);
-		} else {
-			FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, nullptr, true);
-			FT_Glyph_Get_CBox( glyph, FT_GLYPH_BBOX_PIXELS, &bbox );
+	size_t textSize = style.textSize();
+	bool hasBorder = style.hasBorder();
+	size_t brdSize = style.brdSize();
 
-			FT_BitmapGlyph bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(glyph);
-			cv::Mat glyph_img(bitmapGlyph->bitmap.rows, bitmapGlyph->bitmap.width, CV_8UC1, bitmapGlyph->bitmap.buffer, bitmapGlyph->bitmap.pitch);
-			int top = max_top - bbox.yMax;
+	CVGlyphCache::ReadGuard guard(*mCache, mReaderId);
+	int error = layoutRun(text, textSize, hasBorder, brdSize);
+	if (error != 0)
+		return error;
 
-			int left = x + bitmapGlyph->left;
-			if (left < 0)
-				left = 0;
-			cv::Rect rect(left, top, bitmapGlyph->bitmap.width, bitmapGlyph->bitmap.rows);
+	long max_top = mRunTop;
+	long min_bottom = mRunBottom;
 
-			cv::Mat gray_part(gray_outline, rect);
-			glyph_img.copyTo(gray_part);
+	// one spare byte a row for blitMono
+	width = (int)mRunWidth;
+	int rows = (int)(max_top - min_bottom);
+	int bytes = (width + 7) / 8 + 1;
+	fill.create(rows, bytes, CV_8UC1);
+	fill.setTo(cv::Scalar::all(0));
+	outline.create(rows, bytes, CV_8UC1);
+	outline.setTo(cv::Scalar::all(0));
 
-			x += std::max(bbox.xMax, mFace->glyph->advance.x >> 6);
-			FT_Done_Glyph(glyph);
-		}
+	int x = 0;
+	for (size_t i = 0; i < mRun.size(); i++) {
+		const RunGlyph& rg = mRun[i];
+		const CVGlyph& outer = hasBorder ? *rg.border : *rg.fill;
+
+		// glyphs loaded in another mode have no packed bits to copy
+		if (rg.fill->monoWidth)
+			blitMono(*rg.fill, x, max_top, width, fill);
+		if (hasBorder && rg.border->monoWidth)
+			blitMono(*rg.border, x, max_top, width, outline);
+
+		x += std::max(outer.right, outer.advance) + (hasBorder ? (int)brdSize : 0);
+	}
+
+	if (!hasBorder)
+		fill.copyTo(outline);
+	if (baseline)
+		*baseline = (int)max_top;
+	return 0;
+}
+
+int CVRenderText::renderPremultiplied(const CVTextView& text, const CVTextStyle& style, cv::Mat& bgra, int* baseline) {
+	int error = renderCoverage(text, style, mOutline, mFill, baseline);
+	if (error != 0)
+		return error;
+
+	cv::Point origin = cvComposeBGRA(style, mOutline, mFill, bgra);
+	if (baseline)
+		*baseline += origin.y;
+	return 0;
+}
+
+int CVRenderText::renderAlpha(const CVTextView& text, const CVTextStyle& style, cv::Mat& alpha, int* baseline) {
+	int error = renderCoverage(text, style, mOutline, mFill, baseline);
+	if (error != 0)
+		return error;
+
+	cv::Point origin = cvComposeAlpha(style, mOutline, mFill, alpha);
+	if (baseline)
+		*baseline += origin.y;
+	return 0;
+}
+
+int CVRenderText::measure(const CVTextView& text, const CVTextStyle& style, std::vector<Placement>& placements, int* width) {
+	if (!mFace)
+		return -1;
+
+	CVGlyphCache::ReadGuard guard(*mCache, mReaderId);
+	int error = layoutRun(text, style.textSize(), style.hasBorder(), style.brdSize());
+	if (error != 0)
+		return error;
+
+	placements.resize(mRun.size());
+	int x = 0;
+	for (size_t i = 0; i < mRun.size(); i++) {
+		const RunGlyph& rg = mRun[i];
+		const CVGlyph& outer = style.hasBorder() ? *rg.border : *rg.fill;
+
+		Placement& p = placements[i];
+		p.codepoint = rg.codepoint;
+		p.glyph_index = rg.glyph_index;
+		p.x = x;
+		p.width = std::max(outer.right, outer.advance) + (style.hasBorder() ? (int)style.brdSize() : 0);
+		x += p.width;
+	}
+
+	if (width)
+		*width = x;
+	return 0;
+}
+
+cv::Rect CVRenderText::labelRect(cv::Size labelSize, cv::Point pos, Justify xMargin, Justify yMargin, cv::Size dstSize) {
+	switch (xMargin) {
+	case CVRenderText::CENTER_MARGIN:
+		pos.x -= labelSize.width / 2;
+		break;
+	case CVRenderText::RIGHT_MARGIN:
+		pos.x -= labelSize.width;
+		break;
+	default:
+		break;
+	}
+
+	switch (yMargin) {
+	case CVRenderText::CENTER_MARGIN:
+		pos.y -= labelSize.height / 2;
+		break;
+	case CVRenderText::BOTTOM_MARGIN:
+		pos.y -= labelSize.height;
+		break;
+	default:
+		break;
+	}
+
+	if (pos.x < 0)
+		pos.x = 0;
+	if (pos.y < 0)
+		pos.y = 0;
+
+	cv::Rect rect = cv::Rect(pos, labelSize) & cv::Rect(cv::Point(0, 0), dstSize);
+	return rect.area() > 0 ? rect : cv::Rect();
+}
+
+int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const CVTextView& text, const CVTextStyle& style, Justify xMargin, Justify yMargin, 
+		CVSaveUnder* saveUnder, CVDirtyRegion* dirty)
+{
+	// small status text: solid colours bit blitted, effects are not drawn
+	if (mRenderMode == MONO_RENDER && dstImg.type() == CV_8UC3) {
+		int width;
+		int error = renderMask(text, style, mOutline, mFill, width);
+		if (error != 0)
+			return error;
+
+		cv::Rect rect = labelRect(cv::Size(width, mFill.rows), pos, xMargin, yMargin, dstImg.size());
+		if (saveUnder)
+			saveUnder->save(dstImg, rect);
+		if (rect.area() == 0)
+			return 0;
+
+		cv::Mat blendImg(dstImg, rect);
+		cvBlitMask(style, mOutline, mFill, blendImg);
+		if (dirty)
+			dirty->add(rect);
+		return 0;
 	}
 
+	int error = renderCoverage(text, style, mOutline, mFill);
+	if (error != 0)
+		return error;
+
+	// effects widen the label, they are positioned as part of it
+	cvEffectCoverage(style, mOutline, mFill, mEffects);
+	const cv::Mat& outline = mEffects.outline;
+	const cv::Mat& fill = mEffects.fill;
+
+	cv::Rect rect = labelRect(fill.size(), pos, xMargin, yMargin, dstImg.size());
+	if (saveUnder)
+		saveUnder->save(dstImg, rect);
+	if (rect.area() == 0)
+		return 0;
+
+	cv::Rect rectText(0, 0, rect.width, rect.height);
+	cv::Mat blendImg(dstImg, rect);
+	cvBlendCoverage(style, outline(rectText), fill(rectText), blendImg, 
+		mEffects.shadow.empty() ? cv::Mat() : mEffects.shadow(rectText), mEffects.glow.empty() ? cv::Mat() : mEffects.glow(rectText));
+	if (dirty)
+		dirty->add(rect);
+	return 0;
+}
+
+int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const wchar_t* text, const CVTextStyle& style, Justify xMargin, Justify yMargin, 
+		CVSaveUnder* saveUnder, CVDirtyRegion* dirty)
+{
+	return renderText(dstImg, pos, CVTextView::wide(text), style, xMargin, yMargin, saveUnder, dirty);
+}
+
+int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const char* text, const CVTextStyle& style, Justify xMargin, Justify yMargin, 
+		CVSaveUnder* saveUnder, CVDirtyRegion* dirty)
+{
+	return renderText(dstImg, pos, CVTextView::utf8(text), style, xMargin, yMargin, saveUnder, dirty);
+}
+
+int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const CVTextView& text, size_t textSize, Justify xMargin, Justify yMargin, 
+		cv::Scalar textColor, bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity, 
+		CVSaveUnder* saveUnder, CVDirtyRegion* dirty)
+{
+	cv::Mat gray_outline;
+	cv::Mat gray_text;
+
+	int error = renderCoverage(text, textSize, hasBorder, brdSize, gray_outline, gray_text);
+	if (error != 0)
+		return error;
+
+	unsigned int total_width = gray_outline.cols;
+	unsigned int max_height = gray_outline.rows;
+
 	// re-calculate position to render text over destination image
 	switch (xMargin) {
 	case CVRenderText::CENTER_MARGIN:
@@ -255,142 +914,46 @@ int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const wchar_t* text
 	if (height > dstImg.rows - pos.y)
 		height = dstImg.rows - pos.y;
 
+	// nothing of the label is inside the destination
+	if (width <= 0 || height <= 0) {
+		if (saveUnder)
+			saveUnder->save(dstImg, cv::Rect());
+		return 0;
+	}
+
 	// get ROI actual from destination image
 	cv::Rect rect(pos.x, pos.y, width, height);
 
 	// rebuild ROI of image text overlayed in case of out of destination image
 	cv::Rect rectText(0, 0, width, height);
 
-	cv::Mat gray_bgr(gray_outline.size(), CV_8UC1, cv::Scalar::all(255));
-	cv::Mat gray_img(gray_outline.size(), CV_8UC1, cv::Scalar::all(255));
-	cv::Mat outline_clr(gray_outline.size(), CV_8UC3, brdColor);
-	cv::Mat text_clr(gray_text.size(), CV_8UC3, textColor);
-	cv::Mat bgrd_clr(gray_outline.size(), CV_8UC3, bgrColor);
-	cv::Mat coeffMat(gray_outline.size(), CV_32FC3);
-	std::vector<cv::Mat> coeff;
-
-	// calculate gray for background
-	cv::subtract(gray_bgr, gray_outline, gray_bgr);
-	// calculate gray for image
-	cv::subtract(gray_img, gray_outline, gray_img);
-	
-	if (hasBorder) {
-		// fill outline color
-		coeff.push_back(gray_outline);
-		coeff.push_back(gray_outline);
-		coeff.push_back(gray_outline);
-
-		cv::merge(coeff, coeffMat);
-		cv::multiply(coeffMat, outline_clr, outline_clr, 1.0/255.0);
-		// fill text color
-		coeff.clear();
-		coeff.push_back(gray_text);
-		coeff.push_back(gray_text);
-		coeff.push_back(gray_text);
-		cv::merge(coeff, coeffMat);
-		cv::multiply(coeffMat, text_clr, text_clr, 1.0/255.0);
-	} else {
-		// fill text color
-		coeff.push_back(gray_outline);
-		coeff.push_back(gray_outline);
-		coeff.push_back(gray_outline);
-
-		cv::merge(coeff, coeffMat);
-		cv::multiply(coeffMat, text_clr, text_clr, 1.0/255.0);
-	}
-
-	if (hasBackgrnd) {
-		// normalize opacity
-		if (bgrOpacity > 1.0)
-			bgrOpacity = 1.0;
-		else if (bgrOpacity < 0.0)
-			bgrOpacity = 0.0;
-
-		double opacity = 0.9375*bgrOpacity + 0.0625; //(ax+b)
-		gray_img *= (1.0 - opacity);
-		gray_bgr *= opacity;
-
-		// fill background color
-		coeff.clear();
-		coeff.push_back(gray_bgr);
-		coeff.push_back(gray_bgr);
-		coeff.push_back(gray_bgr);
-		cv::merge(coeff, coeffMat);
-		cv::multiply(coeffMat, bgrd_clr, bgrd_clr, 1.0/255.0);
-	
-		cv::Mat blendImg(dstImg, rect);
-		cv::Mat blendOutline(outline_clr, rectText);
-		cv::Mat blendText(text_clr, rectText);
-		cv::Mat blendBgrd(bgrd_clr, rectText);
-
-		// build overlayed ROI of destination image with gray scale
-		coeff.clear();
-		coeff.push_back(gray_img(rectText));
-		coeff.push_back(gray_img(rectText));
-		coeff.push_back(gray_img(rectText));
-		cv::merge(coeff, coeffMat);
-		cv::multiply(coeffMat, blendImg, blendImg, 1.0/255.0);
-
-		// now merge text to image
-		if (hasBorder) {
-			cv::add(blendImg, blendOutline, blendImg);
-
-			gray_img = cv::Mat(gray_text.size(), CV_8UC1, cv::Scalar::all(255));
-			cv::subtract(gray_img, gray_text, gray_img);
-			coeff.clear();
-			coeff.push_back(gray_img(rectText));
-			coeff.push_back(gray_img(rectText));
-			coeff.push_back(gray_img(rectText));
-			cv::merge(coeff, coeffMat);
-			cv::multiply(coeffMat, blendImg, blendImg, 1.0/255.0);
-			cv::add(blendImg, blendText, blendImg);
-		} else {
-			cv::add(blendImg, blendText, blendImg);
-		}
+	// the blend tables are rebuilt only when the appearance changes
+	if (!mLegacyStyle.matches(textSize, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity))
+		mLegacyStyle = CVTextStyle(textSize, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity);
 
-		cv::add(blendImg, blendBgrd, blendImg);
-	}
-	else {
-		cv::Mat blendImg(dstImg, rect);
-		cv::Mat blendOutline(outline_clr, rectText);
-		cv::Mat blendText(text_clr, rectText);
-
-		// build overlayed ROI of destination image with gray scale
-		coeff.clear();
-		coeff.push_back(gray_bgr(rectText));
-		coeff.push_back(gray_bgr(rectText));
-		coeff.push_back(gray_bgr(rectText));
-		cv::merge(coeff, coeffMat);
-		cv::multiply(coeffMat, blendImg, blendImg, 1.0/255.0);
-
-		// now merge text to image
-		if (hasBorder) {
-			cv::add(blendImg, blendOutline, blendImg);
-			gray_img = cv::Mat(gray_text.size(), CV_8UC1, cv::Scalar::all(255));
-			cv::subtract(gray_img, gray_text, gray_img);
-			coeff.clear();
-			coeff.push_back(gray_img(rectText));
-			coeff.push_back(gray_img(rectText));
-			coeff.push_back(gray_img(rectText));
-			cv::merge(coeff, coeffMat);
-			cv::multiply(coeffMat, blendImg, blendImg, 1.0/255.0);
-			cv::add(blendImg, blendText, blendImg);
-		} else {
-			cv::add(blendImg, blendText, blendImg);
-		}
-	}
+	if (saveUnder)
+		saveUnder->save(dstImg, rect);
 
-	
+	cv::Mat blendImg(dstImg, rect);
+	cvBlendCoverage(mLegacyStyle, gray_outline(rectText), gray_text(rectText), blendImg);
+
+	if (dirty)
+		dirty->add(rect);
 
 	return 0;
 }
 
-int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const char* text, size_t textSize, Justify xMargin, Justify yMargin, 
-		cv::Scalar textColor, bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity)
+int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const wchar_t* text, size_t textSize, Justify xMargin, Justify yMargin, 
+		cv::Scalar textColor, bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity, 
+		CVSaveUnder* saveUnder, CVDirtyRegion* dirty)
 {
-	std::string mb(text);
-	std::wstring ws(mb.size(), L' ');
+	return renderText(dstImg, pos, CVTextView::wide(text), textSize, xMargin, yMargin, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity, saveUnder, dirty);
+}
 
-	ws.resize(std::mbstowcs(&ws[0], mb.c_str(), mb.size()));
-	return renderText(dstImg, pos, ws.c_str(), textSize, xMargin, yMargin, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity);
+int CVRenderText::renderText(cv::Mat &dstImg, cv::Point pos, const char* text, size_t textSize, Justify xMargin, Justify yMargin, 
+		cv::Scalar textColor, bool hasBorder, size_t brdSize, cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity, 
+		CVSaveUnder* saveUnder, CVDirtyRegion* dirty)
+{
+	// UTF-8, decoded in place whatever the process locale is
+	return renderText(dstImg, pos, CVTextView::utf8(text), textSize, xMargin, yMargin, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity, saveUnder, dirty);
 }
\ No newline at end of file
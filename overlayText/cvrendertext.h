@@ -7,18 +7,98 @@
 #include FT_STROKER_H
 
 #include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 // OpenCV headers
 #include <opencv2/core/core.hpp>
 
+#include "cvcharmap.h"
+#include "cvcompositor.h"
+#include "cvglyphcache.h"
+#include "cvdirtyregion.h"
+#include "cvsaveunder.h"
+#include "cvtextstyle.h"
+#include "cvtextview.h"
+
 class CVRenderText
 {
 protected:
 	FT_Library mLibrary;
 	FT_Stroker mStroker;
 	FT_Face mFace;
+	CVCharMap mCharMap;
 	bool mInitialized;
 	std::string mFontName;
+
+	// glyph cache, possibly shared with other renderers
+	std::shared_ptr<CVGlyphCache> mCache;
+	int mReaderId;
+	uint32_t mFaceId;
+	size_t mFaceSize;		// size last passed to FT_Set_Char_Size
+	size_t mStrokerSize;	// radius last passed to FT_Stroker_Set
+
+	// one laid out character: the fill glyph and, with border, the stroked one;
+	// only valid while a read guard on mCache is held
+	struct RunGlyph {
+		uint32_t codepoint;
+		FT_UInt glyph_index;
+		const CVGlyph* fill;
+		const CVGlyph* border;
+	};
+	std::vector<RunGlyph> mRun;
+	// coverage scratch of the style based renderText
+	cv::Mat mOutline;
+	cv::Mat mFill;
+	CVEffectBuffers mEffects;
+	// style of the argument based renderText, kept while its arguments repeat
+	CVTextStyle mLegacyStyle;
+	// extent of mRun, accumulated while it is built
+	unsigned int mRunWidth;
+	long mRunTop;
+	long mRunBottom;
+	bool mRunFixedExtent;	// mRunTop/mRunBottom come from the face metrics
+
+	// background glyph preparation
+	struct PrepareJob {
+		std::string font;
+		std::vector<uint32_t> text;	// code points
+		std::vector<size_t> sizes;
+		bool hasBorder;
+		size_t brdSize;
+		bool mono;
+		int hinting;
+	};
+	std::thread mWorker;
+	std::mutex mJobMutex;
+	std::condition_variable mJobCond;
+	std::deque<PrepareJob> mJobs;
+	size_t mBusyJobs;
+	bool mStopWorker;
+
+	void initLibrary();
+	// cached glyph; embedded strikes and bitmap fonts load without rasterizing
+	int loadGlyph(FT_UInt glyph_index, size_t textSize, size_t stroke, const CVGlyph*& glyph);
+	int addRunGlyph(uint32_t codepoint, size_t textSize, bool hasBorder, size_t brdSize);
+	// fills mRun; the caller holds a read guard on mCache
+	int layoutRun(const CVTextView& text, size_t textSize, bool hasBorder, size_t brdSize);
+	// BASELINE_LAYOUT rows above and below the baseline from the face metrics;
+	// false when the face has none
+	bool faceExtent(size_t textSize, bool hasBorder, size_t brdSize, long& top, long& bottom);
+	// FT_Set_Char_Size, or the nearest strike of a bitmap font
+	int selectSize(size_t textSize);
+	int queueJob(PrepareJob& job);
+	void workerLoop();
+
+private:
+	CVRenderText(const CVRenderText&);
+	CVRenderText& operator=(const CVRenderText&);
+
 public:
 	typedef enum {
 		LEFT_MARGIN,
@@ -28,16 +108,146 @@ public:
 		CENTER_MARGIN
 	} Justify;
 
+	typedef enum {
+		TIGHT_LAYOUT,
+		BASELINE_LAYOUT
+	} Layout;
+
+	typedef enum {
+		ANTIALIASED_RENDER,
+		MONO_RENDER
+	} RenderMode;
+
+	// glyph loading presets, cheapest last
+	typedef enum {
+		FULL_HINTING,	// FT_LOAD_DEFAULT: bytecode interpreter or autohinter
+		LIGHT_HINTING,	// FT_LOAD_TARGET_LIGHT: vertical autohinting only
+		FAST_HINTING	// FT_LOAD_NO_HINTING
+	} Hinting;
+
+	// where a character of the text ended up in the label
+	struct Placement {
+		uint32_t codepoint;
+		FT_UInt glyph_index;
+		int x;		// pen position
+		int width;	// advance including border
+	};
+
+protected:
+	Layout mLayout;
+	RenderMode mRenderMode;
+	Hinting mHinting;
+
+public:
 	CVRenderText();
+	explicit CVRenderText(const std::shared_ptr<CVGlyphCache>& cache);
 	virtual ~CVRenderText();
 
 	int setFont(const char* path_to_font);
+	const std::string& fontName() const { return mFontName; }
+
+	// fill the code point to glyph index table of the current font at once,
+	// instead of lazily while rendering
+	void loadCharMap() { mCharMap.load(); }
+
+	// TIGHT_LAYOUT (default) fits the label box to the glyphs of the text.
+	// BASELINE_LAYOUT sizes it from the face's ascender and descender plus
+	// the border, so every label of a given size has the same height and
+	// baseline whatever its content; glyph parts beyond them are clipped.
+	void setLayout(Layout layout) { mLayout = layout; }
+	Layout layout() const { return mLayout; }
+
+	// MONO_RENDER rasterizes with FT_RENDER_MODE_MONO, or takes the face's
+	// embedded bitmap strikes, and keeps 1-bpp glyphs in the cache. Meant
+	// for small status text: the style based renderText then bit blits solid
+	// colours instead of blending coverage. The coverage outputs still work,
+	// with mono glyphs expanded to 0/255.
+	void setRenderMode(RenderMode mode) { mRenderMode = mode; }
+	RenderMode renderMode() const { return mRenderMode; }
+
+	// Hinting preset of the glyphs loaded from now on. Presets are cached
+	// apart, so renderers with different presets can share a cache.
+	void setHinting(Hinting hinting) { mHinting = hinting; }
+	Hinting hinting() const { return mHinting; }
+
+	// share glyphs between renderers; each renderer keeps its own FreeType face
+	void setGlyphCache(const std::shared_ptr<CVGlyphCache>& cache);
+	std::shared_ptr<CVGlyphCache> glyphCache() const { return mCache; }
+
+	// Rasterize the glyphs of text into the glyph cache on a background thread,
+	// so that the renderText call that first shows it only hits warm entries.
+	int prepare(const CVTextView& text, size_t textSize, bool hasBorder = true, size_t brdSize = 2);
+	int prepare(const wchar_t* text, size_t textSize, bool hasBorder = true, size_t brdSize = 2);
+	int prepare(const char* text, size_t textSize, bool hasBorder = true, size_t brdSize = 2);
+	int prepare(const CVTextView& text, const CVTextStyle& style);
+
+	// Startup warm-up of every character of charset at each of the sizes, also asynchronous.
+	int warmup(const wchar_t* charset, const std::vector<size_t>& sizes, bool hasBorder = true, size_t brdSize = 2);
+
+	// block until all prepare/warmup requests have been processed
+	void waitPrepared();
+
+	// synchronous version of prepare, run on the calling thread
+	int cacheGlyphs(const CVTextView& text, size_t textSize, bool hasBorder = true, size_t brdSize = 2);
+	int cacheGlyphs(const wchar_t* text, size_t textSize, bool hasBorder = true, size_t brdSize = 2);
+
+	// Coverage stage of renderText: border and fill coverage (CV_8UC1, the
+	// border one all zero without border), the baseline row and optionally
+	// the position of every character.
+	int renderCoverage(const CVTextView& text, size_t textSize, bool hasBorder, size_t brdSize, cv::Mat& outline, cv::Mat& fill, int* baseline = NULL, 
+		std::vector<Placement>* placements = NULL);
+	int renderCoverage(const wchar_t* text, size_t textSize, bool hasBorder, size_t brdSize, cv::Mat& outline, cv::Mat& fill, int* baseline = NULL);
+	int renderCoverage(const CVTextView& text, const CVTextStyle& style, cv::Mat& outline, cv::Mat& fill, int* baseline = NULL, 
+		std::vector<Placement>* placements = NULL);
+
+	// Packed 1-bpp border and fill masks of the label (CV_8UC1, (width + 7) / 8
+	// bytes a row, leftmost pixel in the most significant bit) for
+	// cvBlitMask, width gets the label width in pixels. Without border the
+	// border mask is the fill one. Meant for MONO_RENDER.
+	int renderMask(const CVTextView& text, const CVTextStyle& style, cv::Mat& outline, cv::Mat& fill, int& width, int* baseline = NULL);
+
+	// Placement of every character as renderCoverage would lay it out, from
+	// the cached glyph metrics and without drawing; width gets the total.
+	int measure(const CVTextView& text, const CVTextStyle& style, std::vector<Placement>& placements, int* width = NULL);
+
+	// Label output for external compositors, no destination image involved:
+	// premultiplied BGRA (CV_8UC4) into bgra, or the combined alpha of border,
+	// fill and background (CV_8UC1) into alpha. bgra and alpha are reused when
+	// they already have the label's size and type, so a caller-provided buffer
+	// is written in place.
+	int renderPremultiplied(const CVTextView& text, const CVTextStyle& style, cv::Mat& bgra, int* baseline = NULL);
+	int renderAlpha(const CVTextView& text, const CVTextStyle& style, cv::Mat& alpha, int* baseline = NULL);
+
+	// Area of a dstSize image covered by a labelSize label drawn at pos with
+	// the given justification, as renderText places it; empty when outside.
+	static cv::Rect labelRect(cv::Size labelSize, cv::Point pos, Justify xMargin, Justify yMargin, cv::Size dstSize);
+
+	// renderText with a precompiled style: no argument normalization and no
+	// temporary colour mats per call, the blend runs on the style's tables.
+	// With saveUnder, the pixels under the label are saved before blending;
+	// the modified rectangle is added to dirty.
+	int renderText(cv::Mat &dstImg, cv::Point pos, const CVTextView& text, const CVTextStyle& style, Justify xMargin = CENTER_MARGIN, Justify yMargin = CENTER_MARGIN, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
+	int renderText(cv::Mat &dstImg, cv::Point pos, const wchar_t* text, const CVTextStyle& style, Justify xMargin = CENTER_MARGIN, Justify yMargin = CENTER_MARGIN, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
+	int renderText(cv::Mat &dstImg, cv::Point pos, const char* text, const CVTextStyle& style, Justify xMargin = CENTER_MARGIN, Justify yMargin = CENTER_MARGIN, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
+
+	// Text in any of the encodings of CVTextView, with explicit length. With
+	// saveUnder, the pixels under the label are saved before blending; the
+	// modified rectangle is added to dirty.
+	int renderText(cv::Mat &dstImg, cv::Point pos, const CVTextView& text, size_t textSize, Justify xMargin = CENTER_MARGIN, Justify yMargin = CENTER_MARGIN, 
+		cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
 
 	int renderText(cv::Mat &dstImg, cv::Point pos, const wchar_t* text, size_t textSize, Justify xMargin = CENTER_MARGIN, Justify yMargin = CENTER_MARGIN, 
-		cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+		cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
 
+	// text is UTF-8
 	int renderText(cv::Mat &dstImg, cv::Point pos, const char* text, size_t textSize, Justify xMargin = CENTER_MARGIN, Justify yMargin = CENTER_MARGIN, 
-		cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+		cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0, 
+		CVSaveUnder* saveUnder = NULL, CVDirtyRegion* dirty = NULL);
 };
 
 #endif//CV_RENDER_TEXT_H__
\ No newline at end of file
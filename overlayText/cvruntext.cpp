@@ -0,0 +1,121 @@
+#include "cvruntext.h"
+#include "cvcompositor.h"
+
+CVRunText::CVRunText()
+	: mBaseline(0)
+	, mHasHighlight(false)
+	, mProgress(0.0) {
+}
+
+int CVRunText::create(CVRenderText& renderer, const CVTextView& text, const CVTextStyle& style) {
+	int error = renderer.renderCoverage(text, style, mOutline, mFill, &mBaseline, &mPlacements);
+	if (error != 0) {
+		mOutline.release();
+		mFill.release();
+		mPlacements.clear();
+		return error;
+	}
+
+	// the highlight colours carry over, on the new style
+	mStyle = style;
+	mStyle.clearEffects();
+	if (mHasHighlight)
+		mHighlight = runStyle(mHighlight.textColor(), mHighlight.brdColor());
+	mProgress = 0.0;
+	clearRuns();
+	return 0;
+}
+
+CVTextStyle CVRunText::runStyle(cv::Scalar textColor, cv::Scalar brdColor) const {
+	return CVTextStyle(mStyle.textSize(), textColor, mStyle.hasBorder(), mStyle.brdSize(), brdColor, 
+		mStyle.hasBackgrnd(), mStyle.bgrColor(), mStyle.bgrOpacity());
+}
+
+void CVRunText::paintRun(size_t r) {
+	const Run& run = mRuns[r];
+	size_t end = std::min(run.end, mPlacements.size());
+	for (size_t i = run.begin; i < end; i++) {
+		const CVRenderText::Placement& p = mPlacements[i];
+		int x1 = std::min(p.x + p.width, mFill.cols);
+		for (int x = std::max(p.x, 0); x < x1; x++)
+			mColumnStyle[x] = (int)r + 1;
+	}
+}
+
+void CVRunText::addRun(size_t begin, size_t end, cv::Scalar textColor, cv::Scalar brdColor) {
+	Run run;
+	run.begin = begin;
+	run.end = end;
+	run.textColor = textColor;
+	run.brdColor = brdColor;
+	mRuns.push_back(run);
+
+	// later runs win, so only the new run's columns change
+	mStyles.push_back(runStyle(textColor, brdColor));
+	paintRun(mRuns.size() - 1);
+}
+
+void CVRunText::clearRuns() {
+	mRuns.clear();
+	mStyles.assign(1, mStyle);
+	mColumnStyle.assign(mFill.cols, 0);
+}
+
+void CVRunText::setHighlight(cv::Scalar textColor, cv::Scalar brdColor) {
+	mHasHighlight = true;
+	mHighlight = runStyle(textColor, brdColor);
+}
+
+double CVRunText::charPosition(size_t index, double fraction) const {
+	if (index >= mPlacements.size())
+		return mFill.cols;
+	const CVRenderText::Placement& p = mPlacements[index];
+	return p.x + fraction * p.width;
+}
+
+void CVRunText::blendColumns(cv::Mat& dstImg, const cv::Rect& rect, int x0, int x1, const CVTextStyle& style) const {
+	cv::Rect src(x0, 0, x1 - x0, rect.height);
+	cv::Mat blendImg = dstImg(cv::Rect(rect.x + x0, rect.y, x1 - x0, rect.height));
+	cvBlendCoverage(style, mOutline(src), mFill(src), blendImg);
+}
+
+cv::Rect CVRunText::draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, 
+		CVSaveUnder* saveUnder) {
+	cv::Rect rect;
+	if (!mFill.empty())
+		rect = CVRenderText::labelRect(mFill.size(), pos, xMargin, yMargin, dstImg.size());
+	if (saveUnder)
+		saveUnder->save(dstImg, rect);
+	if (rect.area() == 0)
+		return cv::Rect();
+
+	// style index -1 is the highlight
+	int split = mHasHighlight ? std::max(0, std::min((int)std::floor(mProgress), rect.width)) : 0;
+	double frac = mHasHighlight ? mProgress - std::floor(mProgress) : 0.0;
+
+	// spans of columns sharing one style
+	int x = 0;
+	while (x < rect.width) {
+		if (x == split && frac > 0.0 && split < rect.width) {
+			// split column: both looks, mixed by the fraction
+			cv::Rect col(rect.x + x, rect.y, 1, rect.height);
+			cv::Rect src(x, 0, 1, rect.height);
+			dstImg(col).copyTo(mSplitColumn);
+			cvBlendCoverage(mHighlight, mOutline(src), mFill(src), mSplitColumn);
+			blendColumns(dstImg, rect, x, x + 1, mStyles[mColumnStyle[x]]);
+			cv::Mat dst = dstImg(col);
+			cv::addWeighted(mSplitColumn, frac, dst, 1.0 - frac, 0.0, dst);
+			x++;
+			continue;
+		}
+
+		int style = x < split ? -1 : mColumnStyle[x];
+		int end = x + 1;
+		while (end < rect.width && end != split && (end < split ? -1 : mColumnStyle[end]) == style)
+			end++;
+		blendColumns(dstImg, rect, x, end, style < 0 ? mHighlight : mStyles[style]);
+		x = end;
+	}
+
+	return rect;
+}
@@ -0,0 +1,80 @@
+#ifndef CV_RUN_TEXT_H__
+#define CV_RUN_TEXT_H__
+
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvdirtyregion.h"
+#include "cvrendertext.h"
+#include "cvsaveunder.h"
+#include "cvtextstyle.h"
+
+// A label whose characters can have their own fill and border colours
+// (highlighted keywords) and whose left part up to a progress position is
+// drawn in highlight colours (karaoke). The coverage is rendered once;
+// changing runs or progress only changes which style tables each column is
+// blended with. Style effects are not drawn.
+class CVRunText
+{
+public:
+	// colours of code points [begin, end) of the text
+	struct Run {
+		size_t begin;
+		size_t end;
+		cv::Scalar textColor;
+		cv::Scalar brdColor;
+	};
+
+protected:
+	cv::Mat mOutline;
+	cv::Mat mFill;
+	int mBaseline;
+	std::vector<CVRenderText::Placement> mPlacements;
+
+	CVTextStyle mStyle;
+	std::vector<Run> mRuns;
+	// mStyles[0] is the base style, then one per run; each is built once,
+	// when its run is added
+	std::vector<CVTextStyle> mStyles;
+	std::vector<int> mColumnStyle;	// style index of every label column
+	bool mHasHighlight;
+	CVTextStyle mHighlight;
+	double mProgress;		// columns left of it are highlighted
+	cv::Mat mSplitColumn;	// highlight look of the split column
+
+	CVTextStyle runStyle(cv::Scalar textColor, cv::Scalar brdColor) const;
+	// the columns of mRuns[r] get its style
+	void paintRun(size_t r);
+	void blendColumns(cv::Mat& dstImg, const cv::Rect& rect, int x0, int x1, const CVTextStyle& style) const;
+
+public:
+	CVRunText();
+
+	// returns the renderer's error code
+	int create(CVRenderText& renderer, const CVTextView& text, const CVTextStyle& style);
+
+	// later runs win where they overlap
+	void addRun(size_t begin, size_t end, cv::Scalar textColor, cv::Scalar brdColor = cv::Scalar::all(0));
+	void clearRuns();
+
+	// colours left of the progress position
+	void setHighlight(cv::Scalar textColor, cv::Scalar brdColor = cv::Scalar::all(0));
+	// in label columns, fractions blend the split column
+	void setProgress(double x) { mProgress = x; }
+	double progress() const { return mProgress; }
+	// column of character index, plus fraction of its advance
+	double charPosition(size_t index, double fraction = 0.0) const;
+
+	// blend positioned like renderText; returns the modified rectangle
+	cv::Rect draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin = CVRenderText::CENTER_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::CENTER_MARGIN, CVSaveUnder* saveUnder = NULL);
+
+	bool empty() const { return mFill.empty(); }
+	cv::Size size() const { return mFill.size(); }
+	int baseline() const { return mBaseline; }
+	const std::vector<CVRenderText::Placement>& placements() const { return mPlacements; }
+};
+
+#endif//CV_RUN_TEXT_H__
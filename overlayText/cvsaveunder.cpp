@@ -0,0 +1,35 @@
+#include "cvsaveunder.h"
+
+CVSaveUnder::CVSaveUnder()
+	: mTarget(NULL) {
+}
+
+void CVSaveUnder::save(const cv::Mat& dstImg, const cv::Rect& rect) {
+	mRect = rect & cv::Rect(0, 0, dstImg.cols, dstImg.rows);
+	mTarget = dstImg.data;
+	if (mRect.area() <= 0) {
+		mRect = cv::Rect();
+		return;
+	}
+
+	// copyTo only reallocates when the size or type changes
+	dstImg(mRect).copyTo(mPixels);
+}
+
+bool CVSaveUnder::restore(cv::Mat& dstImg) {
+	if (mTarget == NULL || mTarget != dstImg.data)
+		return false;
+
+	if (mRect.area() > 0 && mRect == (mRect & cv::Rect(0, 0, dstImg.cols, dstImg.rows))) {
+		cv::Mat roi = dstImg(mRect);
+		mPixels.copyTo(roi);
+	}
+	mTarget = NULL;
+	return true;
+}
+
+void CVSaveUnder::release() {
+	mPixels.release();
+	mRect = cv::Rect();
+	mTarget = NULL;
+}
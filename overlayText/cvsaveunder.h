@@ -0,0 +1,33 @@
+#ifndef CV_SAVE_UNDER_H__
+#define CV_SAVE_UNDER_H__
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+// Destination pixels under a label, saved just before it is blended, so that
+// the label can be taken off a reused frame buffer by copying one rectangle
+// back instead of redrawing the frame. The pixel buffer is reused between
+// saves. Overlapping labels have to be restored in the reverse order of
+// drawing.
+class CVSaveUnder
+{
+protected:
+	cv::Mat mPixels;
+	cv::Rect mRect;
+	const uchar* mTarget;	// image the pixels came from
+
+public:
+	CVSaveUnder();
+
+	void save(const cv::Mat& dstImg, const cv::Rect& rect);
+
+	// copy the saved pixels back and forget them; false when nothing was
+	// saved or dstImg is not the image they came from
+	bool restore(cv::Mat& dstImg);
+
+	bool empty() const { return mTarget == NULL; }
+	const cv::Rect& rect() const { return mRect; }
+	void release();
+};
+
+#endif//CV_SAVE_UNDER_H__
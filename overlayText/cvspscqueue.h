@@ -0,0 +1,78 @@
+#ifndef CV_SPSC_QUEUE_H__
+#define CV_SPSC_QUEUE_H__
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring. push and pop never lock; the
+// blocking variants back off to a short sleep while the ring is full/empty.
+template <typename T>
+class CVSpscQueue
+{
+protected:
+	std::vector<T> mRing;
+	size_t mMask;
+	// producer and consumer indices on separate cache lines
+	std::atomic<size_t> mHead;
+	char mPad[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> mTail;
+
+	static void backoff(int& spins) {
+		if (++spins < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+private:
+	CVSpscQueue(const CVSpscQueue&);
+	CVSpscQueue& operator=(const CVSpscQueue&);
+
+public:
+	// capacity is rounded up to a power of two
+	explicit CVSpscQueue(size_t capacity)
+		: mHead(0)
+		, mTail(0) {
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		mRing.resize(size);
+		mMask = size - 1;
+	}
+
+	bool tryPush(const T& value) {
+		size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) > mMask)
+			return false;
+		mRing[tail & mMask] = value;
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T& value) {
+		size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return false;
+		value = mRing[head & mMask];
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	void push(const T& value) {
+		int spins = 0;
+		while (!tryPush(value))
+			backoff(spins);
+	}
+
+	void pop(T& value) {
+		int spins = 0;
+		while (!tryPop(value))
+			backoff(spins);
+	}
+
+	size_t capacity() const { return mMask + 1; }
+};
+
+#endif//CV_SPSC_QUEUE_H__
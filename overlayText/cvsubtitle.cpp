@@ -0,0 +1,360 @@
+#include "cvsubtitle.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef _MSC_VER
+#pragma warning(disable:4996)
+#endif
+
+static bool cueBefore(const CVSubtitleCue& a, const CVSubtitleCue& b) {
+	return a.startMs < b.startMs;
+}
+
+// UTF-8 to wchar_t, UTF-16 surrogates where wchar_t is 16 bits
+static std::wstring utf8ToWide(const std::string& s) {
+	CVTextView text(s.data(), s.size());
+	std::wstring ws;
+	ws.reserve(s.size());
+
+	for (size_t pos = 0; pos < text.length(); ) {
+		uint32_t cp = text.next(pos);
+		if (sizeof(wchar_t) == 2 && cp > 0xFFFF) {
+			cp -= 0x10000;
+			ws.push_back((wchar_t)(0xD800 + (cp >> 10)));
+			ws.push_back((wchar_t)(0xDC00 + (cp & 0x3FF)));
+		} else {
+			ws.push_back((wchar_t)cp);
+		}
+	}
+
+	return ws;
+}
+
+static std::string trim(const std::string& s) {
+	size_t b = s.find_first_not_of(" \t\r\n");
+	if (b == std::string::npos)
+		return "";
+	size_t e = s.find_last_not_of(" \t\r\n");
+	return s.substr(b, e - b + 1);
+}
+
+// drop markup between open and close, e.g. <i> in SRT or {\b1} in ASS
+static std::string stripTags(const std::string& s, char open, char close) {
+	std::string out;
+	out.reserve(s.size());
+	bool inTag = false;
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == open)
+			inTag = true;
+		else if (inTag && s[i] == close)
+			inTag = false;
+		else if (!inTag)
+			out.push_back(s[i]);
+	}
+	return out;
+}
+
+// HH:MM:SS,mmm (SRT) or H:MM:SS.cc (ASS)
+static bool parseTime(const std::string& s, double& ms) {
+	int h, m, sec;
+	char sep;
+	char frac[8] = { 0 };
+	if (sscanf(s.c_str(), "%d:%d:%d%c%7[0-9]", &h, &m, &sec, &sep, frac) < 3)
+		return false;
+
+	// fraction digits are tenths, hundredths or thousandths
+	double f = 0.0;
+	double scale = 100.0;
+	for (int i = 0; frac[i] && i < 3; i++) {
+		f += (frac[i] - '0') * scale;
+		scale /= 10.0;
+	}
+	ms = ((h * 60.0 + m) * 60.0 + sec) * 1000.0 + f;
+	return true;
+}
+
+CVSubtitleEngine::CVSubtitleEngine(CVRenderText& renderer)
+	: mRenderer(renderer)
+	, mStyle(32, cv::Scalar::all(255), true, 2, cv::Scalar::all(0), false)
+	, mBottomMargin(24)
+	, mLookaheadMs(2000.0)
+	, mNextCue(0)
+	, mNextPrepare(0)
+	, mLastTime(0.0) {
+}
+
+int CVSubtitleEngine::load(const std::string& path) {
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file)
+		return -1;
+
+	std::stringstream content;
+	content << file.rdbuf();
+
+	std::string ext = path.size() > 4 ? path.substr(path.size() - 4) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if (ext == ".ass" || ext == ".ssa")
+		return parseAss(content.str());
+	return parseSrt(content.str());
+}
+
+int CVSubtitleEngine::parseSrt(const std::string& content) {
+	std::vector<CVSubtitleCue> cues;
+	std::istringstream in(content);
+	std::string line;
+	CVSubtitleCue cue;
+	bool inCue = false;
+
+	while (std::getline(in, line)) {
+		// skip a UTF-8 byte order mark
+		if (line.size() >= 3 && (unsigned char)line[0] == 0xEF && (unsigned char)line[1] == 0xBB && (unsigned char)line[2] == 0xBF)
+			line = line.substr(3);
+		line = trim(line);
+
+		if (!inCue) {
+			size_t arrow = line.find("-->");
+			if (arrow == std::string::npos)
+				continue;	// cue number or garbage
+
+			if (!parseTime(trim(line.substr(0, arrow)), cue.startMs) || !parseTime(trim(line.substr(arrow + 3)), cue.endMs))
+				continue;
+			cue.text.clear();
+			inCue = true;
+		} else if (line.empty()) {
+			if (!cue.text.empty())
+				cues.push_back(cue);
+			inCue = false;
+		} else {
+			if (!cue.text.empty())
+				cue.text.push_back(L'\n');
+			cue.text += utf8ToWide(stripTags(line, '<', '>'));
+		}
+	}
+	if (inCue && !cue.text.empty())
+		cues.push_back(cue);
+
+	std::stable_sort(cues.begin(), cues.end(), cueBefore);
+	mCues.swap(cues);
+	reset(0.0);
+	return 0;
+}
+
+int CVSubtitleEngine::parseAss(const std::string& content) {
+	std::vector<CVSubtitleCue> cues;
+	std::istringstream in(content);
+	std::string line;
+	bool inEvents = false;
+
+	// field positions from the Format line, defaults of the ASS spec
+	int startField = 1;
+	int endField = 2;
+	int fieldCount = 10;
+
+	while (std::getline(in, line)) {
+		line = trim(line);
+		if (line.empty())
+			continue;
+
+		if (line[0] == '[') {
+			inEvents = (line == "[Events]");
+			continue;
+		}
+		if (!inEvents)
+			continue;
+
+		size_t colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+		std::string kind = line.substr(0, colon);
+		std::string rest = line.substr(colon + 1);
+
+		if (kind == "Format") {
+			std::istringstream fields(rest);
+			std::string field;
+			int index = 0;
+			while (std::getline(fields, field, ',')) {
+				field = trim(field);
+				if (field == "Start")
+					startField = index;
+				else if (field == "End")
+					endField = index;
+				index++;
+			}
+			fieldCount = index;
+		} else if (kind == "Dialogue") {
+			// the last field (Text) may itself contain commas
+			std::vector<std::string> fields;
+			size_t start = 0;
+			for (int i = 0; i < fieldCount - 1; i++) {
+				size_t comma = rest.find(',', start);
+				if (comma == std::string::npos)
+					break;
+				fields.push_back(trim(rest.substr(start, comma - start)));
+				start = comma + 1;
+			}
+			if ((int)fields.size() != fieldCount - 1)
+				continue;
+			std::string text = stripTags(rest.substr(start), '{', '}');
+
+			CVSubtitleCue cue;
+			if (!parseTime(fields[startField], cue.startMs) || !parseTime(fields[endField], cue.endMs))
+				continue;
+
+			// \N and \n are line breaks, \h a hard space
+			std::string plain;
+			for (size_t i = 0; i < text.size(); i++) {
+				if (text[i] == '\\' && i + 1 < text.size() && (text[i + 1] == 'N' || text[i + 1] == 'n')) {
+					plain.push_back('\n');
+					i++;
+				} else if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == 'h') {
+					plain.push_back(' ');
+					i++;
+				} else {
+					plain.push_back(text[i]);
+				}
+			}
+
+			cue.text = utf8ToWide(plain);
+			if (!cue.text.empty())
+				cues.push_back(cue);
+		}
+	}
+
+	std::stable_sort(cues.begin(), cues.end(), cueBefore);
+	mCues.swap(cues);
+	reset(0.0);
+	return 0;
+}
+
+void CVSubtitleEngine::setStyle(size_t textSize, cv::Scalar textColor, bool hasBorder, size_t brdSize, 
+		cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) {
+	setStyle(CVTextStyle(textSize, textColor, hasBorder, brdSize, brdColor, hasBackgrnd, bgrColor, bgrOpacity));
+}
+
+void CVSubtitleEngine::setStyle(const CVTextStyle& style) {
+	mStyle = style;
+
+	// sprites of the old style are stale
+	reset(mLastTime);
+}
+
+void CVSubtitleEngine::reset(double timeMs) {
+	mActive.clear();
+	mNextCue = 0;
+	mNextPrepare = 0;
+	mLastTime = timeMs;
+}
+
+int CVSubtitleEngine::renderCue(const CVSubtitleCue& cue, CVTextSprite& sprite) {
+	size_t lines = 0;
+	int width = 0;
+	int height = 0;
+
+	// render each line, then stack them centered into one coverage image
+	std::wistringstream in(cue.text);
+	std::wstring line;
+	while (std::getline(in, line)) {
+		if (line.empty())
+			continue;
+		if (mLineOutlines.size() <= lines) {
+			mLineOutlines.resize(lines + 1);
+			mLineFills.resize(lines + 1);
+		}
+
+		int error = mRenderer.renderCoverage(CVTextView(line.c_str(), line.size()), mStyle, mLineOutlines[lines], mLineFills[lines]);
+		if (error != 0)
+			return error;
+
+		width = std::max(width, mLineFills[lines].cols);
+		height += mLineFills[lines].rows;
+		lines++;
+	}
+
+	// nothing but line breaks: the sprite stays empty and is not drawn
+	if (lines == 0)
+		return 0;
+
+	mOutline.create(height, width, CV_8UC1);
+	mOutline.setTo(cv::Scalar::all(0));
+	mFill.create(height, width, CV_8UC1);
+	mFill.setTo(cv::Scalar::all(0));
+
+	int y = 0;
+	for (size_t i = 0; i < lines; i++) {
+		cv::Rect rect((width - mLineFills[i].cols) / 2, y, mLineFills[i].cols, mLineFills[i].rows);
+		mLineOutlines[i].copyTo(mOutline(rect));
+		mLineFills[i].copyTo(mFill(rect));
+		y += rect.height;
+	}
+
+	sprite.compose(mOutline, mFill, mStyle);
+	return 0;
+}
+
+int CVSubtitleEngine::update(double timeMs) {
+	// seeking backwards restarts the schedule
+	if (timeMs < mLastTime)
+		reset(timeMs);
+	mLastTime = timeMs;
+
+	// evict cues that ended
+	std::map<size_t, CVTextSprite>::iterator it = mActive.begin();
+	while (it != mActive.end()) {
+		if (mCues[it->first].endMs <= timeMs)
+			mActive.erase(it++);
+		else
+			++it;
+	}
+
+	// activate cues that started, rendering their sprite once
+	for (; mNextCue < mCues.size() && mCues[mNextCue].startMs <= timeMs; mNextCue++) {
+		const CVSubtitleCue& cue = mCues[mNextCue];
+		if (cue.endMs <= timeMs)
+			continue;
+
+		int error = renderCue(cue, mActive[mNextCue]);
+		if (error != 0) {
+			mActive.erase(mNextCue);
+			return error;
+		}
+	}
+
+	// warm the glyphs of cues starting soon in the background
+	if (mNextPrepare < mNextCue)
+		mNextPrepare = mNextCue;
+	for (; mNextPrepare < mCues.size() && mCues[mNextPrepare].startMs <= timeMs + mLookaheadMs; mNextPrepare++) {
+		// the lines as renderCue splits them, without the breaks
+		std::wistringstream in(mCues[mNextPrepare].text);
+		std::wstring line;
+		std::wstring glyphs;
+		while (std::getline(in, line))
+			glyphs += line;
+		if (!glyphs.empty())
+			mRenderer.prepare(CVTextView(glyphs.c_str(), glyphs.size()), mStyle);
+	}
+
+	return 0;
+}
+
+cv::Rect CVSubtitleEngine::draw(cv::Mat& frame, double timeMs) {
+	cv::Rect modified;
+	if (update(timeMs) != 0)
+		return modified;
+
+	// earliest cue at the bottom, later ones stacked above it
+	int y = frame.rows - mBottomMargin;
+	for (std::map<size_t, CVTextSprite>::const_iterator it = mActive.begin(); it != mActive.end(); ++it) {
+		const CVTextSprite& sprite = it->second;
+		if (sprite.empty())
+			continue;
+
+		cv::Rect rect = sprite.draw(frame, cv::Point(frame.cols / 2, y), CVRenderText::CENTER_MARGIN, CVRenderText::BOTTOM_MARGIN);
+		modified = modified.area() > 0 ? (modified | rect) : rect;
+		y -= sprite.size().height;
+	}
+
+	return modified;
+}
@@ -0,0 +1,80 @@
+#ifndef CV_SUBTITLE_H__
+#define CV_SUBTITLE_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+#include "cvtextsprite.h"
+
+struct CVSubtitleCue
+{
+	double startMs;
+	double endMs;
+	std::wstring text;	// lines separated by '\n'
+};
+
+// Burns SRT or basic ASS subtitles into frames. Each cue is rendered into a
+// sprite once, when it becomes active, reused for every frame it covers and
+// dropped when it ends, so a frame costs one sprite blend per visible cue.
+// Glyphs of upcoming cues are warmed on the renderer's background thread.
+class CVSubtitleEngine
+{
+protected:
+	CVRenderText& mRenderer;
+	std::vector<CVSubtitleCue> mCues;	// sorted by start time
+
+	CVTextStyle mStyle;
+	int mBottomMargin;
+	double mLookaheadMs;
+
+	// schedule
+	size_t mNextCue;		// first cue not activated yet
+	size_t mNextPrepare;	// first cue whose glyphs were not queued yet
+	double mLastTime;
+	std::map<size_t, CVTextSprite> mActive;
+
+	// scratch coverage, reused between cues
+	cv::Mat mOutline;
+	cv::Mat mFill;
+	std::vector<cv::Mat> mLineOutlines;
+	std::vector<cv::Mat> mLineFills;
+
+	int renderCue(const CVSubtitleCue& cue, CVTextSprite& sprite);
+	void reset(double timeMs);
+
+private:
+	CVSubtitleEngine(const CVSubtitleEngine&);
+	CVSubtitleEngine& operator=(const CVSubtitleEngine&);
+
+public:
+	explicit CVSubtitleEngine(CVRenderText& renderer);
+
+	// picks the parser from the extension (.srt, .ass, .ssa); files are UTF-8
+	int load(const std::string& path);
+	int parseSrt(const std::string& content);
+	int parseAss(const std::string& content);
+
+	void setStyle(size_t textSize, cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, 
+		cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = false, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+	void setStyle(const CVTextStyle& style);
+	const CVTextStyle& style() const { return mStyle; }
+	void setBottomMargin(int margin) { mBottomMargin = margin; }
+	// how far ahead glyphs of upcoming cues are prepared
+	void setLookahead(double ms) { mLookaheadMs = ms; }
+
+	// activate and evict cues for the given time
+	int update(double timeMs);
+
+	// update, then blend the active cues bottom up; returns the modified area
+	cv::Rect draw(cv::Mat& frame, double timeMs);
+
+	const std::vector<CVSubtitleCue>& cues() const { return mCues; }
+	size_t activeCount() const { return mActive.size(); }
+};
+
+#endif//CV_SUBTITLE_H__
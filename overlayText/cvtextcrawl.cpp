@@ -0,0 +1,208 @@
+#include "cvtextcrawl.h"
+#include "cvcompositor.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CV_CRAWL_SSE2
+#endif
+
+// dst = dst * k / 255 + c over n bytes, with c and k interpolated between
+// each byte and the one 3 bytes (a pixel) further, weight w1 of 256 on it,
+// then faded by a of 256; the SSE2 lanes do cvFadeSprite and cvBlendSprite
+static void blendRow(uchar* d, const uchar* c, const uchar* k, int n, int w1, int a) {
+	int w0 = 256 - w1;
+	int j = 0;
+
+#ifdef CV_CRAWL_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wa = _mm_set1_epi16((short)w0);
+	const __m128i wb = _mm_set1_epi16((short)w1);
+	const __m128i half = _mm_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi16((short)a);
+	const __m128i full = _mm_set1_epi16(255);
+
+	for (; j + 16 <= n; j += 16) {
+		__m128i c0 = _mm_loadu_si128((const __m128i*)(c + j));
+		__m128i c1 = _mm_loadu_si128((const __m128i*)(c + j + 3));
+		__m128i k0 = _mm_loadu_si128((const __m128i*)(k + j));
+		__m128i k1 = _mm_loadu_si128((const __m128i*)(k + j + 3));
+		__m128i dd = _mm_loadu_si128((const __m128i*)(d + j));
+		__m128i out[2];
+
+		for (int h = 0; h < 2; h++) {
+			__m128i cl0 = h ? _mm_unpackhi_epi8(c0, zero) : _mm_unpacklo_epi8(c0, zero);
+			__m128i cl1 = h ? _mm_unpackhi_epi8(c1, zero) : _mm_unpacklo_epi8(c1, zero);
+			__m128i kl0 = h ? _mm_unpackhi_epi8(k0, zero) : _mm_unpacklo_epi8(k0, zero);
+			__m128i kl1 = h ? _mm_unpackhi_epi8(k1, zero) : _mm_unpacklo_epi8(k1, zero);
+			__m128i dl = h ? _mm_unpackhi_epi8(dd, zero) : _mm_unpacklo_epi8(dd, zero);
+
+			// horizontal interpolation, all sums stay below 65536
+			__m128i cc = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(cl0, wa), _mm_mullo_epi16(cl1, wb)), half), 8);
+			__m128i kk = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(kl0, wa), _mm_mullo_epi16(kl1, wb)), half), 8);
+			if (a < 256) {
+				cc = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(cc, alpha), half), 8);
+				kk = _mm_sub_epi16(full, _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(full, kk), alpha), half), 8));
+			}
+
+			// (v + (v >> 8)) >> 8 with v = d * k + 128 rounds d * k / 255
+			__m128i v = _mm_add_epi16(_mm_mullo_epi16(dl, kk), half);
+			v = _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+			out[h] = _mm_add_epi16(v, cc);
+		}
+		_mm_storeu_si128((__m128i*)(d + j), _mm_packus_epi16(out[0], out[1]));
+	}
+#endif
+
+	for (; j < n; j++) {
+		unsigned int cc = (c[j] * w0 + c[j + 3] * w1 + 128) >> 8;
+		unsigned int kk = (k[j] * w0 + k[j + 3] * w1 + 128) >> 8;
+		if (a < 256)
+			cvFadeSprite(cc, kk, a);
+		d[j] = cvBlendSprite(d[j], cc, kk);
+	}
+}
+
+// periods copies of a period plane side by side, plus its first column
+static void tilePlane(const cv::Mat& period, cv::Mat& tiled, int periods) {
+	int width = period.cols;
+	tiled.create(period.rows, periods * width + 1, period.type());
+	for (int p = 0; p < periods; p++)
+		period.copyTo(tiled.colRange(p * width, (p + 1) * width));
+	period.col(0).copyTo(tiled.col(periods * width));
+}
+
+CVTextCrawl::CVTextCrawl()
+	: mPeriod(0)
+	, mTileWidth(0)
+	, mBaseline(0)
+	, mOffset(0.0) {
+}
+
+int CVTextCrawl::create(CVRenderText& renderer, const CVTextView& text, const CVTextStyle& style, int gap) {
+	cv::Mat outline, fill;
+	int error = renderer.renderCoverage(text, style, outline, fill, &mBaseline);
+	if (error != 0)
+		return error;
+
+	// the gap is zero coverage, it shows the background if the style has one
+	mPeriod = fill.cols + std::max(gap, 0);
+	if (mPeriod == 0 || fill.rows == 0) {
+		mPeriod = 0;
+		return 0;
+	}
+
+	cv::Mat periodOutline(fill.rows, mPeriod, CV_8UC1, cv::Scalar::all(0));
+	cv::Mat periodFill(fill.rows, mPeriod, CV_8UC1, cv::Scalar::all(0));
+	outline.copyTo(periodOutline.colRange(0, outline.cols));
+	fill.copyTo(periodFill.colRange(0, fill.cols));
+
+	cv::Mat transmit, innerTransmit;
+	// effects pad the period, their margin becomes part of the loop
+	cv::Point origin = cvComposeSprite(style, periodOutline, periodFill, mPeriodColor, transmit, mPeriodInnerColor, innerTransmit);
+	mPeriod = mPeriodColor.cols;
+	mBaseline += origin.y;
+	cv::Mat planes[3] = { transmit, transmit, transmit };
+	cv::merge(planes, 3, mPeriodTransmit);
+	if (!innerTransmit.empty()) {
+		cv::Mat innerPlanes[3] = { innerTransmit, innerTransmit, innerTransmit };
+		cv::merge(innerPlanes, 3, mPeriodInnerTransmit);
+	} else {
+		mPeriodInnerTransmit.release();
+	}
+
+	mTileWidth = 0;
+	mOffset = 0.0;
+	return 0;
+}
+
+void CVTextCrawl::tile(int windowWidth) {
+	// whole periods covering any offset plus the window and the column
+	// interpolated past its end
+	int needed = mPeriod + windowWidth + 1;
+	if (mTileWidth >= needed)
+		return;
+
+	int periods = (needed + mPeriod - 1) / mPeriod;
+	mTileWidth = periods * mPeriod;
+	tilePlane(mPeriodColor, mColor, periods);
+	tilePlane(mPeriodTransmit, mTransmit, periods);
+	if (!mPeriodInnerTransmit.empty()) {
+		tilePlane(mPeriodInnerColor, mInnerColor, periods);
+		tilePlane(mPeriodInnerTransmit, mInnerTransmit, periods);
+	} else {
+		mInnerColor.release();
+		mInnerTransmit.release();
+	}
+}
+
+void CVTextCrawl::advance(double pixels) {
+	setOffset(mOffset + pixels);
+}
+
+void CVTextCrawl::setOffset(double offset) {
+	if (mPeriod == 0)
+		return;
+	mOffset = std::fmod(offset, (double)mPeriod);
+	if (mOffset < 0)
+		mOffset += mPeriod;
+}
+
+cv::Rect CVTextCrawl::draw(cv::Mat& dstImg, cv::Point pos, int windowWidth, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, 
+		double alpha, CVSaveUnder* saveUnder) {
+	CV_Assert(dstImg.type() == CV_8UC3);
+	cv::Rect rect;
+	if (mPeriod > 0 && windowWidth > 0)
+		rect = CVRenderText::labelRect(cv::Size(windowWidth, mPeriodColor.rows), pos, xMargin, yMargin, dstImg.size());
+	if (saveUnder)
+		saveUnder->save(dstImg, rect);
+
+	int a = cvRound(std::min(std::max(alpha, 0.0), 1.0) * 256);
+	if (rect.area() == 0 || a == 0)
+		return cv::Rect();
+
+	tile(rect.width);
+
+	int whole = (int)mOffset;
+	int frac = (int)((mOffset - whole) * 256.0 + 0.5);
+	if (frac == 256) {
+		whole = (whole + 1) % mPeriod;
+		frac = 0;
+	}
+
+	// the columns read, interpolation included
+	int n = 3 * rect.width;
+	bool staged = !mInnerTransmit.empty();
+	if (staged && a < 256) {
+		mFoldColor.resize(n + 3);
+		mFoldTransmit.resize(n + 3);
+	}
+
+	for (int y = 0; y < rect.height; y++) {
+		const uchar* c = mColor.ptr<uchar>(y) + 3 * whole;
+		const uchar* k = mTransmit.ptr<uchar>(y) + 3 * whole;
+		uchar* d = dstImg.ptr<uchar>(rect.y + y) + 3 * rect.x;
+		if (!staged) {
+			blendRow(d, c, k, n, frac, a);
+			continue;
+		}
+
+		const uchar* ci = mInnerColor.ptr<uchar>(y) + 3 * whole;
+		const uchar* ki = mInnerTransmit.ptr<uchar>(y) + 3 * whole;
+		if (a == 256) {
+			blendRow(d, c, k, n, frac, a);
+			blendRow(d, ci, ki, n, frac, a);
+			continue;
+		}
+
+		// a fade applies to the label as a whole, fold the stages first
+		for (int j = 0; j < n + 3; j++) {
+			mFoldColor[j] = cvBlendSprite(c[j], ci[j], ki[j]);
+			mFoldTransmit[j] = (uchar)CVTextStyle::div255(k[j] * ki[j]);
+		}
+		blendRow(d, &mFoldColor[0], &mFoldTransmit[0], n, frac, a);
+	}
+
+	return rect;
+}
@@ -0,0 +1,66 @@
+#ifndef CV_TEXT_CRAWL_H__
+#define CV_TEXT_CRAWL_H__
+
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+#include "cvtextstyle.h"
+
+// News style crawl: a message scrolling right to left in a loop. The message
+// and the gap after it are rendered and composited once into a strip, tiled
+// so that any window is contiguous. A frame blends a window of the strip at
+// a fractional offset, interpolating neighbouring columns, so the text moves
+// smoothly instead of in whole pixel steps.
+class CVTextCrawl
+{
+protected:
+	// composited strip, transmission replicated to three channels so that
+	// the frame loop runs over plain byte rows; mTileWidth columns plus one.
+	// The inner planes are the sprite's second stage, empty without border.
+	cv::Mat mColor;
+	cv::Mat mTransmit;
+	cv::Mat mInnerColor;
+	cv::Mat mInnerTransmit;
+	// one period, message and gap
+	cv::Mat mPeriodColor;
+	cv::Mat mPeriodTransmit;
+	cv::Mat mPeriodInnerColor;
+	cv::Mat mPeriodInnerTransmit;
+	// a faded row's stages folded into one
+	std::vector<uchar> mFoldColor;
+	std::vector<uchar> mFoldTransmit;
+	int mPeriod;
+	int mTileWidth;
+	int mBaseline;
+	double mOffset;		// in [0, mPeriod)
+
+	void tile(int windowWidth);
+
+public:
+	CVTextCrawl();
+
+	// gap is the number of blank columns between repetitions; returns the
+	// renderer's error code
+	int create(CVRenderText& renderer, const CVTextView& text, const CVTextStyle& style, int gap = 64);
+
+	// scroll the text left by pixels, fractions included
+	void advance(double pixels);
+	void setOffset(double offset);
+	double offset() const { return mOffset; }
+
+	// Blend windowWidth columns at the current offset, positioned like
+	// renderText and faded by alpha, saving the pixels under it with
+	// saveUnder. Returns the modified rectangle.
+	cv::Rect draw(cv::Mat& dstImg, cv::Point pos, int windowWidth, CVRenderText::Justify xMargin = CVRenderText::LEFT_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::BOTTOM_MARGIN, double alpha = 1.0, CVSaveUnder* saveUnder = NULL);
+
+	bool empty() const { return mPeriod == 0; }
+	int period() const { return mPeriod; }
+	int height() const { return mPeriodColor.rows; }
+	int baseline() const { return mBaseline; }
+};
+
+#endif//CV_TEXT_CRAWL_H__
@@ -0,0 +1,68 @@
+#include "cvtextsprite.h"
+#include "cvcompositor.h"
+
+CVTextSprite::CVTextSprite()
+	: baseline(0) {
+}
+
+void CVTextSprite::compose(const cv::Mat& outline, const cv::Mat& fill, const CVTextStyle& style) {
+	origin = cvComposeSprite(style, outline, fill, color, transmit, innerColor, innerTransmit);
+}
+
+void CVTextSprite::compose(const cv::Mat& outline, const cv::Mat& fill, cv::Scalar textColor, bool hasBorder, 
+		cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) {
+	// the text size only matters for layout, any value does here
+	compose(outline, fill, CVTextStyle(1, textColor, hasBorder, 1, brdColor, hasBackgrnd, bgrColor, bgrOpacity));
+}
+
+cv::Rect CVTextSprite::draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, double alpha, 
+		CVSaveUnder* saveUnder) const {
+	CV_Assert(dstImg.type() == CV_8UC3);
+
+	cv::Rect rect = CVRenderText::labelRect(transmit.size(), pos, xMargin, yMargin, dstImg.size());
+	if (saveUnder)
+		saveUnder->save(dstImg, rect);
+
+	// fully faded out
+	int a = cvRound(std::min(std::max(alpha, 0.0), 1.0) * 256);
+	if (rect.area() == 0 || a == 0)
+		return cv::Rect();
+
+	for (int y = 0; y < rect.height; y++) {
+		cvBlendSpriteRow(dstImg.ptr<uchar>(rect.y + y) + 3 * rect.x, color.ptr<uchar>(y), transmit.ptr<uchar>(y), 
+			staged() ? innerColor.ptr<uchar>(y) : NULL, staged() ? innerTransmit.ptr<uchar>(y) : NULL, rect.width, a);
+	}
+
+	return rect;
+}
+
+CVTextSprite CVTextSprite::roi(const cv::Rect& rect) const {
+	CVTextSprite sprite;
+	sprite.color = color(rect);
+	sprite.transmit = transmit(rect);
+	if (staged()) {
+		sprite.innerColor = innerColor(rect);
+		sprite.innerTransmit = innerTransmit(rect);
+	}
+	sprite.baseline = baseline - rect.y;
+	return sprite;
+}
+
+void CVTextSprite::copyTo(CVTextSprite& dst, const cv::Rect& rect) const {
+	CV_Assert(staged() == dst.staged());
+	color.copyTo(dst.color(rect));
+	transmit.copyTo(dst.transmit(rect));
+	if (staged()) {
+		innerColor.copyTo(dst.innerColor(rect));
+		innerTransmit.copyTo(dst.innerTransmit(rect));
+	}
+}
+
+void CVTextSprite::release() {
+	color.release();
+	transmit.release();
+	innerColor.release();
+	innerTransmit.release();
+	baseline = 0;
+	origin = cv::Point(0, 0);
+}
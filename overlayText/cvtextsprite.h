@@ -0,0 +1,51 @@
+#ifndef CV_TEXT_SPRITE_H__
+#define CV_TEXT_SPRITE_H__
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+
+// A label composited once and blended many times. Everything renderText does
+// after the coverage stage is folded into planes, so that drawing is
+//     dst = dst * transmit / 255 + color
+//     dst = dst * innerTransmit / 255 + innerColor      with border
+// per channel, whatever the border and background settings were. These are
+// the stages of the 8-bit blend, so a sprite draws the same bytes.
+class CVTextSprite
+{
+public:
+	cv::Mat color;		// CV_8UC3, premultiplied label colour
+	cv::Mat transmit;	// CV_8UC1, how much of the destination shows through
+	cv::Mat innerColor;		// CV_8UC3, the text over the border, empty without border
+	cv::Mat innerTransmit;	// CV_8UC1
+	int baseline;		// row of the baseline
+	cv::Point origin;	// where the coverage starts, past the effect padding
+
+	CVTextSprite();
+
+	// Build from the output of CVRenderText::renderCoverage with the same
+	// colour arguments as renderText, or a style.
+	void compose(const cv::Mat& outline, const cv::Mat& fill, const CVTextStyle& style);
+	void compose(const cv::Mat& outline, const cv::Mat& fill, cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, 
+		cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+
+	// Blend onto a CV_8UC3 image, positioned like renderText. alpha fades
+	// the whole label, fill, border and background alike, without
+	// recompositing it. With saveUnder, the pixels under the label are saved
+	// first. Returns the modified rectangle.
+	cv::Rect draw(cv::Mat& dstImg, cv::Point pos, CVRenderText::Justify xMargin = CVRenderText::CENTER_MARGIN, 
+		CVRenderText::Justify yMargin = CVRenderText::CENTER_MARGIN, double alpha = 1.0, CVSaveUnder* saveUnder = NULL) const;
+
+	// headers for rect of every plane, nothing is copied
+	CVTextSprite roi(const cv::Rect& rect) const;
+	// copy the planes into rect of dst's, which have the same stages
+	void copyTo(CVTextSprite& dst, const cv::Rect& rect) const;
+
+	bool empty() const { return transmit.empty(); }
+	bool staged() const { return !innerTransmit.empty(); }
+	cv::Size size() const { return transmit.size(); }
+	void release();
+};
+
+#endif//CV_TEXT_SPRITE_H__
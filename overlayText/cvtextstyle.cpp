@@ -0,0 +1,150 @@
+#include "cvtextstyle.h"
+
+static uint32_t toQ(double v) {
+	return (uint32_t)(v * CVTextStyle::ONE + 0.5);
+}
+
+CVTextStyle::CVTextStyle()
+	: mTextSize(12)
+	, mTextColor(cv::Scalar::all(255))
+	, mHasBorder(true)
+	, mBrdSize(2)
+	, mBrdColor(cv::Scalar::all(0))
+	, mHasBackgrnd(true)
+	, mBgrColor(cv::Scalar::all(0))
+	, mBgrOpacity(0.0) {
+	clearEffects();
+	precompute();
+}
+
+CVTextStyle::CVTextStyle(size_t textSize, cv::Scalar textColor, bool hasBorder, size_t brdSize, 
+		cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity)
+	: mTextSize(textSize)
+	, mTextColor(textColor)
+	, mHasBorder(hasBorder)
+	, mBrdSize(brdSize)
+	, mBrdColor(brdColor)
+	, mHasBackgrnd(hasBackgrnd)
+	, mBgrColor(bgrColor)
+	, mBgrOpacity(bgrOpacity) {
+	clearEffects();
+	precompute();
+}
+
+void CVTextStyle::precompute() {
+	if (mTextSize == 0)
+		mTextSize = 1;
+
+	// a zero radius border is no border
+	if (mBrdSize == 0)
+		mHasBorder = false;
+
+	// normalize opacity
+	if (mBgrOpacity > 1.0)
+		mBgrOpacity = 1.0;
+	else if (mBgrOpacity < 0.0)
+		mBgrOpacity = 0.0;
+
+	mOpacity = mHasBackgrnd ? 0.9375*mBgrOpacity + 0.0625 : 0.0; //(ax+b)
+
+	for (int ch = 0; ch < 3; ch++) {
+		mTextColorQ[ch] = toQ(cv::saturate_cast<uchar>(mTextColor[ch]));
+		mBrdColorQ[ch] = toQ(cv::saturate_cast<uchar>(mBrdColor[ch]));
+		mBgrColorQ[ch] = toQ(cv::saturate_cast<uchar>(mBgrColor[ch]));
+	}
+
+	const cv::Scalar& outer = mHasBorder ? mBrdColor : mTextColor;
+	for (int c = 0; c < 256; c++) {
+		// the float blend scaled its 8-bit mats by (1 - opacity) and opacity
+		// with float products, then multiplied colours by coverage / 255
+		uint32_t uncovered = 255 - c;
+		uchar bgrKeep = 0;
+		if (mHasBackgrnd) {
+			mImageKeep[c] = cv::saturate_cast<uchar>((float)uncovered * (float)(1.0 - mOpacity));
+			bgrKeep = cv::saturate_cast<uchar>((float)uncovered * (float)mOpacity);
+		} else {
+			mImageKeep[c] = (uchar)uncovered;
+		}
+		for (int ch = 0; ch < 3; ch++) {
+			mOuterColor8[c][ch] = (uchar)div255(c * cv::saturate_cast<uchar>(outer[ch]));
+			mInnerColor8[c][ch] = mHasBorder ? (uchar)div255(c * cv::saturate_cast<uchar>(mTextColor[ch])) : 0;
+			mBackground8[c][ch] = (uchar)div255(bgrKeep * cv::saturate_cast<uchar>(mBgrColor[ch]));
+		}
+	}
+}
+
+bool CVTextStyle::matches(size_t textSize, cv::Scalar textColor, bool hasBorder, size_t brdSize, 
+		cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) const {
+	if (hasEffects())
+		return false;
+
+	// compare against the normalized arguments, as precompute leaves them
+	return mTextSize == std::max<size_t>(textSize, 1)
+		&& mTextColor == textColor
+		&& mHasBorder == (hasBorder && brdSize != 0)
+		&& mBrdSize == brdSize
+		&& mBrdColor == brdColor
+		&& mHasBackgrnd == hasBackgrnd
+		&& mBgrColor == bgrColor
+		&& mBgrOpacity == std::min(std::max(bgrOpacity, 0.0), 1.0);
+}
+
+void CVTextStyle::setShadow(cv::Point offset, int blur, cv::Scalar color, double opacity) {
+	mShadowOffset = offset;
+	mShadowBlur = std::max(blur, 0);
+	mShadowColor = color;
+	mShadowOpacity = std::min(std::max(opacity, 0.0), 1.0);
+	mHasShadow = mShadowOpacity > 0.0;
+	precomputeEffects();
+}
+
+void CVTextStyle::setGlow(int radius, cv::Scalar color, double opacity) {
+	mGlowRadius = std::max(radius, 0);
+	mGlowColor = color;
+	mGlowOpacity = std::min(std::max(opacity, 0.0), 1.0);
+	mHasGlow = mGlowOpacity > 0.0 && mGlowRadius > 0;
+	precomputeEffects();
+}
+
+void CVTextStyle::clearEffects() {
+	mHasShadow = false;
+	mShadowOffset = cv::Point(0, 0);
+	mShadowBlur = 0;
+	mShadowColor = cv::Scalar::all(0);
+	mShadowOpacity = 0.0;
+	mHasGlow = false;
+	mGlowRadius = 0;
+	mGlowColor = cv::Scalar::all(0);
+	mGlowOpacity = 0.0;
+	precomputeEffects();
+}
+
+void CVTextStyle::precomputeEffects() {
+	for (int c = 0; c < 256; c++) {
+		double s = mShadowOpacity * c / 255.0;
+		double g = mGlowOpacity * c / 255.0;
+
+		mShadowKeep[c] = toQ(1.0 - s);
+		mGlowKeep[c] = toQ(1.0 - g);
+		for (int ch = 0; ch < 3; ch++) {
+			mShadowColorQ[c][ch] = toQ(s * cv::saturate_cast<uchar>(mShadowColor[ch]));
+			mGlowColorQ[c][ch] = toQ(g * cv::saturate_cast<uchar>(mGlowColor[ch]));
+		}
+	}
+}
+
+void CVTextStyle::effectPadding(int& left, int& top, int& right, int& bottom) const {
+	left = top = right = bottom = 0;
+	if (mHasShadow) {
+		left = std::max(0, mShadowBlur - mShadowOffset.x);
+		right = std::max(0, mShadowBlur + mShadowOffset.x);
+		top = std::max(0, mShadowBlur - mShadowOffset.y);
+		bottom = std::max(0, mShadowBlur + mShadowOffset.y);
+	}
+	if (mHasGlow) {
+		left = std::max(left, mGlowRadius);
+		right = std::max(right, mGlowRadius);
+		top = std::max(top, mGlowRadius);
+		bottom = std::max(bottom, mGlowRadius);
+	}
+}
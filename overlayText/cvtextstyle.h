@@ -0,0 +1,143 @@
+#ifndef CV_TEXT_STYLE_H__
+#define CV_TEXT_STYLE_H__
+
+#include <stdint.h>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+// Set of the renderText appearance arguments. The label part is immutable,
+// and everything derived from it is worked out once in the constructor. That
+// covers the opacity clamp and its 0.9375*x + 0.0625 mapping, fixed-point
+// premultiplied colours and the per-coverage blend tables the compositor
+// runs on.
+//
+// With o the outer coverage (border, or the text itself without border)
+// and t the text coverage over a border, an 8-bit destination channel d
+// goes through the stages of the float mat blend renderText used to run,
+// each rounded to 8 bits as its mats were:
+//     d' = sat(div255(imageKeep[o] * d) + outerColor8[o])
+//     d' = sat(div255((255 - t) * d') + innerColor8[t])      with border
+//     d' = sat(d' + background8[o])                          with background
+// which gives the same bytes (overlayText --check-blend compares them).
+// 16-bit destinations run the same stages rounded to 16 bits, which stays
+// within one 8-bit step of them; sprites keep the stages as two planes.
+//
+// Optional shadow and glow layers go under the label; with e their blurred
+// coverage each one first applies d = d * keep[e] + color[e] to the
+// destination. They widen the label by effectPadding on each side. Unlike
+// the label arguments they can be changed after construction: setShadow,
+// setGlow and clearEffects rebuild the effect tables (precomputeEffects)
+// at once and leave the label tables as they are.
+class CVTextStyle
+{
+public:
+	enum { FRACTION_BITS = 15, ONE = 1 << FRACTION_BITS };
+	typedef uint32_t ColorQ[3];
+	typedef uchar Color8[3];
+
+	// round(x / 255) for x up to 255 * 255, the rounding of the float stages
+	static uint32_t div255(uint32_t x) {
+		x += 128;
+		return (x + (x >> 8)) >> 8;
+	}
+
+protected:
+	size_t mTextSize;
+	cv::Scalar mTextColor;
+	bool mHasBorder;
+	size_t mBrdSize;
+	cv::Scalar mBrdColor;
+	bool mHasBackgrnd;
+	cv::Scalar mBgrColor;
+	double mBgrOpacity;		// clamped to [0, 1]
+	double mOpacity;		// effective background opacity, 0 without background
+
+	// premultiplied colours, Q15 per 8-bit channel value
+	uint32_t mTextColorQ[3];
+	uint32_t mBrdColorQ[3];
+	uint32_t mBgrColorQ[3];
+
+	// 8-bit stages of the float blend, indexed by 8-bit coverage
+	uchar mImageKeep[256];
+	Color8 mOuterColor8[256];
+	Color8 mInnerColor8[256];
+	Color8 mBackground8[256];
+
+	// effects
+	bool mHasShadow;
+	cv::Point mShadowOffset;
+	int mShadowBlur;
+	cv::Scalar mShadowColor;
+	double mShadowOpacity;
+	bool mHasGlow;
+	int mGlowRadius;
+	cv::Scalar mGlowColor;
+	double mGlowOpacity;
+
+	uint32_t mShadowKeep[256];
+	ColorQ mShadowColorQ[256];
+	uint32_t mGlowKeep[256];
+	ColorQ mGlowColorQ[256];
+
+	void precompute();
+	void precomputeEffects();
+
+public:
+	// defaults match renderText
+	CVTextStyle();
+	explicit CVTextStyle(size_t textSize, cv::Scalar textColor = cv::Scalar::all(255), bool hasBorder = true, size_t brdSize = 2, 
+		cv::Scalar brdColor = cv::Scalar::all(0), bool hasBackgrnd = true, cv::Scalar bgrColor = cv::Scalar::all(0), double bgrOpacity = 0.0);
+
+	size_t textSize() const { return mTextSize; }
+	const cv::Scalar& textColor() const { return mTextColor; }
+	bool hasBorder() const { return mHasBorder; }
+	size_t brdSize() const { return mBrdSize; }
+	// Border radius of the stroker in 26.6, 0 without border. The style does
+	// not own an FT_Stroker: stroked glyphs are cached per radius and shared
+	// by every style with that radius, so the renderer keeps one stroker and
+	// only calls FT_Stroker_Set on a cache miss with a new radius.
+	long strokeRadius() const { return mHasBorder ? (long)mBrdSize * 64 : 0; }
+	const cv::Scalar& brdColor() const { return mBrdColor; }
+	bool hasBackgrnd() const { return mHasBackgrnd; }
+	const cv::Scalar& bgrColor() const { return mBgrColor; }
+	double bgrOpacity() const { return mBgrOpacity; }
+	double opacity() const { return mOpacity; }
+
+	// whether the constructor arguments would build this style, so callers
+	// taking them one by one can keep its tables
+	bool matches(size_t textSize, cv::Scalar textColor, bool hasBorder, size_t brdSize, 
+		cv::Scalar brdColor, bool hasBackgrnd, cv::Scalar bgrColor, double bgrOpacity) const;
+
+	const uint32_t* textColorQ() const { return mTextColorQ; }
+	const uint32_t* brdColorQ() const { return mBrdColorQ; }
+	const uint32_t* bgrColorQ() const { return mBgrColorQ; }
+
+	const uchar* imageKeep() const { return mImageKeep; }
+	const Color8* outerColor8() const { return mOuterColor8; }
+	const Color8* innerColor8() const { return mInnerColor8; }
+	const Color8* background8() const { return mBackground8; }
+
+	// drop shadow of the label's outer coverage, offset and box blurred by
+	// blur pixels; opacity 0 removes it
+	void setShadow(cv::Point offset, int blur = 2, cv::Scalar color = cv::Scalar::all(0), double opacity = 0.6);
+	// blurred halo of radius pixels around the label; opacity 0 removes it
+	void setGlow(int radius, cv::Scalar color = cv::Scalar::all(255), double opacity = 0.8);
+	void clearEffects();
+
+	bool hasShadow() const { return mHasShadow; }
+	bool hasGlow() const { return mHasGlow; }
+	bool hasEffects() const { return mHasShadow || mHasGlow; }
+	cv::Point shadowOffset() const { return mShadowOffset; }
+	int shadowBlur() const { return mShadowBlur; }
+	int glowRadius() const { return mGlowRadius; }
+	// columns and rows the effects add around the label coverage
+	void effectPadding(int& left, int& top, int& right, int& bottom) const;
+
+	const uint32_t* shadowKeep() const { return mShadowKeep; }
+	const ColorQ* shadowColorQ() const { return mShadowColorQ; }
+	const uint32_t* glowKeep() const { return mGlowKeep; }
+	const ColorQ* glowColorQ() const { return mGlowColorQ; }
+};
+
+#endif//CV_TEXT_STYLE_H__
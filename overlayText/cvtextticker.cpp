@@ -0,0 +1,148 @@
+#include "cvtextticker.h"
+
+CVTextTicker::CVTextTicker(CVRenderText& renderer, const CVTextStyle& style)
+	: mRenderer(renderer)
+	, mStyle(style)
+	, mStart(0)
+	, mEnd(0)
+	, mHeight(0)
+	, mBaseline(0) {
+	// pieces are composited one by one, effects would not line up across them
+	mStyle.clearEffects();
+}
+
+int CVTextTicker::renderPiece(const CVTextView& text) {
+	// every piece gets the same line box, whatever its glyphs
+	CVRenderText::Layout saved = mRenderer.layout();
+	mRenderer.setLayout(CVRenderText::BASELINE_LAYOUT);
+	int baseline = 0;
+	int error = mRenderer.renderCoverage(text, mStyle, mOutline, mFill, &baseline, &mPlacements);
+	mRenderer.setLayout(saved);
+	if (error != 0)
+		return error;
+
+	if (mHeight == 0) {
+		mHeight = mFill.rows;
+		mBaseline = baseline;
+	}
+
+	// fonts without scalable metrics fall back to a tight box; line it up
+	// on the baseline and clip it to the strip height, the zero coverage
+	// around it composites to the background like the rest of the strip
+	if (mFill.rows != mHeight || baseline != mBaseline) {
+		cv::Mat outline(mHeight, mFill.cols, CV_8UC1, cv::Scalar::all(0));
+		cv::Mat fill(mHeight, mFill.cols, CV_8UC1, cv::Scalar::all(0));
+		cv::Rect rect = cv::Rect(0, mBaseline - baseline, mFill.cols, mFill.rows) & cv::Rect(0, 0, fill.cols, fill.rows);
+		if (rect.area() > 0) {
+			cv::Rect src(rect.x, rect.y - (mBaseline - baseline), rect.width, rect.height);
+			mOutline(src).copyTo(outline(rect));
+			mFill(src).copyTo(fill(rect));
+		}
+		mOutline = outline;
+		mFill = fill;
+	}
+
+	mPiece.compose(mOutline, mFill, mStyle);
+	return 0;
+}
+
+void CVTextTicker::reserve(int front, int back) {
+	if (!mStrip.empty() && mStart >= front && mStrip.size().width - mEnd >= back)
+		return;
+
+	// grow geometrically, leaving the slack split between both ends
+	int live = mEnd - mStart;
+	int capacity = std::max(256, 2 * (live + front + back));
+	int start = front + (capacity - live - front - back) / 2;
+
+	CVTextSprite strip;
+	strip.color.create(mHeight, capacity, CV_8UC3);
+	strip.transmit.create(mHeight, capacity, CV_8UC1);
+	if (mStyle.hasBorder()) {
+		strip.innerColor.create(mHeight, capacity, CV_8UC3);
+		strip.innerTransmit.create(mHeight, capacity, CV_8UC1);
+	}
+	if (live > 0)
+		mStrip.roi(cv::Rect(mStart, 0, live, mHeight)).copyTo(strip, cv::Rect(start, 0, live, mHeight));
+
+	mStrip = strip;
+	mStart = start;
+	mEnd = start + live;
+}
+
+void CVTextTicker::copyPiece(int x) {
+	mPiece.copyTo(mStrip, cv::Rect(cv::Point(x, 0), mPiece.size()));
+}
+
+int CVTextTicker::append(const CVTextView& text) {
+	if (text.empty())
+		return 0;
+
+	int error = renderPiece(text);
+	if (error != 0)
+		return error;
+
+	reserve(0, mPiece.size().width);
+	copyPiece(mEnd);
+	mEnd += mPiece.size().width;
+	for (size_t i = 0; i < mPlacements.size(); i++)
+		mWidths.push_back(mPlacements[i].width);
+	return 0;
+}
+
+int CVTextTicker::prepend(const CVTextView& text) {
+	if (text.empty())
+		return 0;
+
+	int error = renderPiece(text);
+	if (error != 0)
+		return error;
+
+	reserve(mPiece.size().width, 0);
+	mStart -= mPiece.size().width;
+	copyPiece(mStart);
+	for (size_t i = mPlacements.size(); i > 0; i--)
+		mWidths.push_front(mPlacements[i - 1].width);
+	return 0;
+}
+
+void CVTextTicker::removeFront(size_t count) {
+	for (; count > 0 && !mWidths.empty(); count--) {
+		mStart += mWidths.front();
+		mWidths.pop_front();
+	}
+}
+
+void CVTextTicker::removeBack(size_t count) {
+	for (; count > 0 && !mWidths.empty(); count--) {
+		mEnd -= mWidths.back();
+		mWidths.pop_back();
+	}
+}
+
+void CVTextTicker::trimFront(int width) {
+	while (!mWidths.empty() && mEnd - mStart > width) {
+		mStart += mWidths.front();
+		mWidths.pop_front();
+	}
+}
+
+void CVTextTicker::clear() {
+	mWidths.clear();
+	mStart = mEnd = mStrip.size().width / 2;
+}
+
+cv::Rect CVTextTicker::draw(cv::Mat& dstImg, cv::Point pos, int offset, int windowWidth, 
+		CVRenderText::Justify xMargin, CVRenderText::Justify yMargin, double alpha, CVSaveUnder* saveUnder) const {
+	cv::Rect window = cv::Rect(mStart + std::max(offset, 0), 0, windowWidth, mHeight) & cv::Rect(mStart, 0, mEnd - mStart, mHeight);
+	if (window.area() <= 0) {
+		if (saveUnder)
+			saveUnder->save(dstImg, cv::Rect());
+		return cv::Rect();
+	}
+
+	// headers over the strip, nothing is copied
+	CVTextSprite sprite = mStrip.roi(window);
+	sprite.baseline = mBaseline;
+	return sprite.draw(dstImg, pos, xMargin, yMargin, alpha, saveUnder);
+}
@@ -0,0 +1,76 @@
+#ifndef CV_TEXT_TICKER_H__
+#define CV_TEXT_TICKER_H__
+
+#include <deque>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvrendertext.h"
+#include "cvtextsprite.h"
+#include "cvtextstyle.h"
+
+// A single line that grows and shrinks at both ends, for log tickers and
+// chat lines. The line is kept composited in a sprite strip with slack on
+// both sides: appending or prepending only lays out and rasterizes the new
+// characters, removing only moves the strip bounds, and a frame blends a
+// window of the strip.
+//
+// Pieces are rendered with BASELINE_LAYOUT so that they all share the
+// baseline and height of the first one. Style effects are not drawn.
+class CVTextTicker
+{
+protected:
+	CVRenderText& mRenderer;
+	CVTextStyle mStyle;
+
+	// strip, live columns are [mStart, mEnd)
+	CVTextSprite mStrip;
+	int mStart;
+	int mEnd;
+	int mHeight;
+	int mBaseline;
+	std::deque<int> mWidths;	// columns of each character, in order
+
+	// piece scratch
+	cv::Mat mOutline;
+	cv::Mat mFill;
+	CVTextSprite mPiece;
+	std::vector<CVRenderText::Placement> mPlacements;
+
+	int renderPiece(const CVTextView& text);
+	void reserve(int front, int back);
+	void copyPiece(int x);
+
+private:
+	CVTextTicker(const CVTextTicker&);
+	CVTextTicker& operator=(const CVTextTicker&);
+
+public:
+	CVTextTicker(CVRenderText& renderer, const CVTextStyle& style);
+
+	// return the renderer's error code
+	int append(const CVTextView& text);
+	int prepend(const CVTextView& text);
+
+	// drop characters from either end
+	void removeFront(size_t count);
+	void removeBack(size_t count);
+	// drop characters from the front until the line is at most width wide
+	void trimFront(int width);
+	void clear();
+
+	size_t length() const { return mWidths.size(); }
+	int width() const { return mEnd - mStart; }
+	int height() const { return mHeight; }
+	int baseline() const { return mBaseline; }
+
+	// Blend columns [offset, offset + windowWidth) of the line, positioned
+	// like renderText and faded by alpha, saving the pixels under it with
+	// saveUnder. Returns the modified rectangle.
+	cv::Rect draw(cv::Mat& dstImg, cv::Point pos, int offset, int windowWidth, 
+		CVRenderText::Justify xMargin = CVRenderText::LEFT_MARGIN, CVRenderText::Justify yMargin = CVRenderText::TOP_MARGIN, double alpha = 1.0, 
+		CVSaveUnder* saveUnder = NULL) const;
+};
+
+#endif//CV_TEXT_TICKER_H__
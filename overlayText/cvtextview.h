@@ -0,0 +1,177 @@
+#ifndef CV_TEXT_VIEW_H__
+#define CV_TEXT_VIEW_H__
+
+#include <stdint.h>
+#include <cstring>
+#include <cwchar>
+
+// A borrowed run of UTF-8, UTF-16 or UTF-32 text with an explicit length.
+// Code points are decoded straight from the caller's buffer, independent of
+// the process locale and without any allocation.
+class CVTextView
+{
+public:
+	typedef enum {
+		UTF8,
+		UTF16,
+		UTF32
+	} Encoding;
+
+	enum { REPLACEMENT = 0xFFFD };
+
+protected:
+	const void* mData;
+	size_t mLength;		// in code units
+	Encoding mEncoding;
+
+	// number of leading bytes below 0x80, checked a word at a time
+	static size_t asciiRun(const unsigned char* p, size_t n) {
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, p + i, sizeof(word));
+			if (word & 0x8080808080808080ULL)
+				break;
+		}
+		while (i < n && p[i] < 0x80)
+			i++;
+		return i;
+	}
+
+	uint32_t decodeUtf8(size_t& pos) const {
+		const unsigned char* p = static_cast<const unsigned char*>(mData);
+		unsigned char c = p[pos++];
+		if (c < 0x80)
+			return c;
+
+		uint32_t cp;
+		size_t extra;
+		uint32_t minimum;
+		if ((c & 0xE0) == 0xC0) {
+			cp = c & 0x1F;
+			extra = 1;
+			minimum = 0x80;
+		} else if ((c & 0xF0) == 0xE0) {
+			cp = c & 0x0F;
+			extra = 2;
+			minimum = 0x800;
+		} else if ((c & 0xF8) == 0xF0) {
+			cp = c & 0x07;
+			extra = 3;
+			minimum = 0x10000;
+		} else {
+			return REPLACEMENT;
+		}
+
+		if (pos + extra > mLength)
+			return REPLACEMENT;
+		for (size_t i = 0; i < extra; i++) {
+			unsigned char cc = p[pos + i];
+			if ((cc & 0xC0) != 0x80)
+				return REPLACEMENT;	// resynchronize on the next lead byte
+			cp = (cp << 6) | (cc & 0x3F);
+		}
+		pos += extra;
+
+		// overlong forms, surrogates and out of range values
+		if (cp < minimum || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+			return REPLACEMENT;
+		return cp;
+	}
+
+	uint32_t decodeUtf16(size_t& pos) const {
+		const uint16_t* p = static_cast<const uint16_t*>(mData);
+		uint32_t c = p[pos++];
+		if (c < 0xD800 || c > 0xDFFF)
+			return c;
+		if (c >= 0xDC00 || pos >= mLength || p[pos] < 0xDC00 || p[pos] > 0xDFFF)
+			return REPLACEMENT;	// unpaired surrogate
+		return 0x10000 + ((c - 0xD800) << 10) + (p[pos++] - 0xDC00);
+	}
+
+public:
+	CVTextView()
+		: mData(""), mLength(0), mEncoding(UTF8) {}
+	CVTextView(const char* utf8, size_t length)
+		: mData(utf8), mLength(length), mEncoding(UTF8) {}
+	CVTextView(const uint16_t* utf16, size_t length)
+		: mData(utf16), mLength(length), mEncoding(UTF16) {}
+	CVTextView(const uint32_t* utf32, size_t length)
+		: mData(utf32), mLength(length), mEncoding(UTF32) {}
+	// UTF-16 on Windows, UTF-32 elsewhere
+	CVTextView(const wchar_t* text, size_t length)
+		: mData(text), mLength(length), mEncoding(sizeof(wchar_t) == 2 ? UTF16 : UTF32) {}
+
+	// NUL-terminated helpers
+	static CVTextView utf8(const char* text) { return CVTextView(text, std::strlen(text)); }
+	static CVTextView wide(const wchar_t* text) { return CVTextView(text, std::wcslen(text)); }
+
+	Encoding encoding() const { return mEncoding; }
+	size_t length() const { return mLength; }
+	bool empty() const { return mLength == 0; }
+	const void* data() const { return mData; }
+
+	// Decode the code point at pos (in code units) and advance pos past it.
+	// Malformed input decodes to U+FFFD.
+	uint32_t next(size_t& pos) const {
+		switch (mEncoding) {
+		case UTF8:
+			return decodeUtf8(pos);
+		case UTF16:
+			return decodeUtf16(pos);
+		default: {
+			uint32_t c = static_cast<const uint32_t*>(mData)[pos++];
+			return c > 0x10FFFF ? (uint32_t)REPLACEMENT : c;
+		}
+		}
+	}
+
+	// Number of code units from pos that are plain ASCII (one code point
+	// each), so callers can take them without going through next().
+	size_t asciiRunAt(size_t pos) const {
+		if (mEncoding == UTF8)
+			return asciiRun(static_cast<const unsigned char*>(mData) + pos, mLength - pos);
+
+		size_t i = pos;
+		if (mEncoding == UTF16) {
+			const uint16_t* p = static_cast<const uint16_t*>(mData);
+			while (i < mLength && p[i] < 0x80)
+				i++;
+		} else {
+			const uint32_t* p = static_cast<const uint32_t*>(mData);
+			while (i < mLength && p[i] < 0x80)
+				i++;
+		}
+		return i - pos;
+	}
+
+	// code unit at pos, only meaningful inside an ASCII run
+	uint32_t unitAt(size_t pos) const {
+		switch (mEncoding) {
+		case UTF8:
+			return static_cast<const unsigned char*>(mData)[pos];
+		case UTF16:
+			return static_cast<const uint16_t*>(mData)[pos];
+		default:
+			return static_cast<const uint32_t*>(mData)[pos];
+		}
+	}
+
+	// number of code points, decoding the whole view
+	size_t count() const {
+		size_t n = 0;
+		for (size_t pos = 0; pos < mLength; ) {
+			size_t run = asciiRunAt(pos);
+			if (run) {
+				n += run;
+				pos += run;
+			} else {
+				next(pos);
+				n++;
+			}
+		}
+		return n;
+	}
+};
+
+#endif//CV_TEXT_VIEW_H__
@@ -0,0 +1,110 @@
+#include "cvvideopipeline.h"
+
+#include <cstring>
+#include <thread>
+
+#include <opencv2/highgui/highgui.hpp>
+
+// queue entry marking the end of the stream
+static const int kEndOfStream = -1;
+
+CVVideoPipeline::CVVideoPipeline(size_t depth)
+	: mDepth(depth < 1 ? 1 : depth)
+	, mFourcc(0) {
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+int CVVideoPipeline::run(const std::string& input, const std::string& output, const OverlayFunc& overlay) {
+	memset(&mStats, 0, sizeof(mStats));
+
+	cv::VideoCapture capture(input);
+	if (!capture.isOpened())
+		return -1;
+
+	double fps = capture.get(CV_CAP_PROP_FPS);
+	if (fps <= 0.0)
+		fps = 25.0;
+	int fourcc = mFourcc ? mFourcc : (int)capture.get(CV_CAP_PROP_FOURCC);
+	if (fourcc == 0)
+		fourcc = CV_FOURCC('M', 'J', 'P', 'G');
+	cv::Size size((int)capture.get(CV_CAP_PROP_FRAME_WIDTH), (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+	cv::VideoWriter writer(output, fourcc, fps, size);
+	if (!writer.isOpened())
+		return -1;
+
+	// one buffer in each stage plus full queues in between
+	size_t count = 2 * mDepth + 3;
+	mFrames.resize(count);
+
+	CVSpscQueue<int> freeFrames(count);		// encode -> decode
+	CVSpscQueue<int> decoded(mDepth);		// decode -> overlay
+	CVSpscQueue<int> overlaid(mDepth);		// overlay -> encode
+	for (size_t i = 0; i < count; i++)
+		freeFrames.push((int)i);
+
+	int64 start = cv::getTickCount();
+	double tickFreq = cv::getTickFrequency();
+
+	std::thread decodeThread([&]() {
+		int64 busy = 0;
+		for (int64 index = 0; ; index++) {
+			int slot;
+			freeFrames.pop(slot);
+
+			int64 t0 = cv::getTickCount();
+			Frame& frame = mFrames[slot];
+			bool ok = capture.read(frame.image);
+			frame.index = index;
+			frame.posMsec = capture.get(CV_CAP_PROP_POS_MSEC);
+			busy += cv::getTickCount() - t0;
+
+			if (!ok || frame.image.empty()) {
+				decoded.push(kEndOfStream);
+				break;
+			}
+			decoded.push(slot);
+		}
+		mStats.decodeSec = busy / tickFreq;
+	});
+
+	std::thread overlayThread([&]() {
+		int64 busy = 0;
+		for (;;) {
+			int slot;
+			decoded.pop(slot);
+			if (slot == kEndOfStream) {
+				overlaid.push(kEndOfStream);
+				break;
+			}
+
+			int64 t0 = cv::getTickCount();
+			overlay(mFrames[slot]);
+			busy += cv::getTickCount() - t0;
+			overlaid.push(slot);
+		}
+		mStats.overlaySec = busy / tickFreq;
+	});
+
+	// encode on the calling thread
+	int64 busy = 0;
+	for (;;) {
+		int slot;
+		overlaid.pop(slot);
+		if (slot == kEndOfStream)
+			break;
+
+		int64 t0 = cv::getTickCount();
+		writer.write(mFrames[slot].image);
+		busy += cv::getTickCount() - t0;
+		mStats.frames++;
+		freeFrames.push(slot);
+	}
+	mStats.encodeSec = busy / tickFreq;
+
+	decodeThread.join();
+	overlayThread.join();
+	mStats.totalSec = (cv::getTickCount() - start) / tickFreq;
+
+	return 0;
+}
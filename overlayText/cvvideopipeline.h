@@ -0,0 +1,56 @@
+#ifndef CV_VIDEO_PIPELINE_H__
+#define CV_VIDEO_PIPELINE_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// OpenCV headers
+#include <opencv2/core/core.hpp>
+
+#include "cvspscqueue.h"
+
+// Burns overlays into a video file. Decode, overlay and encode run on their
+// own threads joined by bounded SPSC queues, so throughput is limited by the
+// slowest stage rather than by the sum of the three. Frames circulate through
+// a fixed pool of buffers that VideoCapture decodes into in place.
+class CVVideoPipeline
+{
+public:
+	struct Frame {
+		cv::Mat image;
+		int64 index;
+		double posMsec;
+	};
+
+	typedef std::function<void(Frame& frame)> OverlayFunc;
+
+	// busy time of each stage over the last run, in seconds
+	struct Stats {
+		int64 frames;
+		double decodeSec;
+		double overlaySec;
+		double encodeSec;
+		double totalSec;
+	};
+
+protected:
+	size_t mDepth;
+	int mFourcc;
+	std::vector<Frame> mFrames;
+	Stats mStats;
+
+public:
+	// depth: frames in flight between two stages
+	explicit CVVideoPipeline(size_t depth = 4);
+
+	// fourcc of the output, 0 keeps the codec of the input
+	void setFourcc(int fourcc) { mFourcc = fourcc; }
+
+	// returns 0 on success, -1 if the input or output cannot be opened
+	int run(const std::string& input, const std::string& output, const OverlayFunc& overlay);
+
+	const Stats& stats() const { return mStats; }
+};
+
+#endif//CV_VIDEO_PIPELINE_H__
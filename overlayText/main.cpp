@@ -4,11 +4,90 @@
 #include <iostream>
 #include <conio.h>
 #include "cvrendertext.h"
+#include "cvbenchmark.h"
+#include "cvosdtext.h"
+#include "cvparagraph.h"
+#include "cvsubtitle.h"
+#include "cvvideopipeline.h"
 #include <opencv2/highgui/highgui.hpp>
 
+// burn a frame counter and timestamp into every frame of a video
+static int burnVideo(const char* input, const char* output, const char* path_to_font) {
+	CVRenderText renderer;
+	if (renderer.setFont(path_to_font) != 0)
+		return -1;
+
+	// only the digits are re-composited from frame to frame
+	CVOsdText osd;
+	CVTextStyle style(24, cv::Scalar::all(255), true, 2, cv::Scalar::all(0), true, cv::Scalar::all(0), 0.3);
+	if (osd.create(renderer, L"frame ######  ##:##:##.###", style) != 0)
+		return -1;
+
+	CVVideoPipeline pipeline;
+	int error = pipeline.run(input, output, [&](CVVideoPipeline::Frame& frame) {
+		int64 ms = (int64)frame.posMsec;
+		std::string digits = cv::format("%06lld%02d%02d%02d%03d", (long long)(frame.index % 1000000), 
+			(int)(ms / 3600000 % 100), (int)(ms / 60000 % 60), (int)(ms / 1000 % 60), (int)(ms % 1000));
+		osd.update(digits.c_str());
+		osd.draw(frame.image, cv::Point(frame.image.cols / 2, frame.image.rows), CVRenderText::CENTER_MARGIN, CVRenderText::BOTTOM_MARGIN);
+	});
+	if (error != 0)
+		return error;
+
+	const CVVideoPipeline::Stats& stats = pipeline.stats();
+	std::cout << stats.frames << " frames in " << stats.totalSec << " s (decode " << stats.decodeSec
+		<< " s, overlay " << stats.overlaySec << " s, encode " << stats.encodeSec << " s)" << std::endl;
+	return 0;
+}
+
+// burn SRT/ASS subtitles into a video
+static int burnSubtitles(const char* input, const char* output, const char* subtitles, const char* path_to_font) {
+	CVRenderText renderer;
+	if (renderer.setFont(path_to_font) != 0)
+		return -1;
+
+	CVSubtitleEngine engine(renderer);
+	if (engine.load(subtitles) != 0)
+		return -1;
+	engine.setStyle(CVTextStyle(32, cv::Scalar::all(255), true, 2, cv::Scalar::all(0), true, cv::Scalar::all(0), 0.3));
+
+	CVVideoPipeline pipeline;
+	int error = pipeline.run(input, output, [&](CVVideoPipeline::Frame& frame) {
+		engine.draw(frame.image, frame.posMsec);
+	});
+	if (error != 0)
+		return error;
+
+	std::cout << pipeline.stats().frames << " frames, " << engine.cues().size() << " cues" << std::endl;
+	return 0;
+}
 
 int main (int argc, char** argv)
 {
+	// overlayText --bench-cache [font]
+	if (argc > 1 && std::string(argv[1]) == "--bench-cache")
+		return benchGlyphCache(argc > 2 ? argv[2] : "./times.ttf");
+
+	// overlayText --bench-hinting [font]
+	if (argc > 1 && std::string(argv[1]) == "--bench-hinting")
+		return benchHinting(argc > 2 ? argv[2] : "./times.ttf");
+
+	// overlayText --check-blend
+	if (argc > 1 && std::string(argv[1]) == "--check-blend")
+		return checkBlendKernels();
+
+	// overlayText --check-cache
+	if (argc > 1 && std::string(argv[1]) == "--check-cache")
+		return checkGlyphCacheReaders();
+
+	// overlayText --video input output [font]
+	if (argc > 3 && std::string(argv[1]) == "--video")
+		return burnVideo(argv[2], argv[3], argc > 4 ? argv[4] : "./times.ttf");
+
+	// overlayText --subtitles input output subtitles.srt|.ass [font]
+	if (argc > 4 && std::string(argv[1]) == "--subtitles")
+		return burnSubtitles(argv[2], argv[3], argv[4], argc > 5 ? argv[5] : "./times.ttf");
+
 	CVRenderText renderer;
 	cv::Mat img = cv::imread("./input.jpg");
 
@@ -29,6 +108,17 @@ int main (int argc, char** argv)
 	renderer.renderText(img, cv::Point(0, img.rows), L"another Việt Nam sample text", 70, CVRenderText::LEFT_MARGIN, CVRenderText::BOTTOM_MARGIN, 
 		cv::Scalar::all(255), true, 4, cv::Scalar::all(0), false);
 
+	// drop shadow, with a precompiled style
+	CVTextStyle shadowed(40, cv::Scalar::all(255), true, 2, cv::Scalar::all(0), false);
+	shadowed.setShadow(cv::Point(4, 4), 3);
+	renderer.renderText(img, cv::Point(img.cols, 0), L"shadowed sample", shadowed, CVRenderText::RIGHT_MARGIN, CVRenderText::TOP_MARGIN);
+
+	// wrapped caption, centered line by line
+	CVParagraph paragraph(renderer);
+	paragraph.setMaxWidth(img.cols / 2);
+	paragraph.renderText(img, cv::Point(img.cols / 2, 0), CVTextView::utf8("a longer caption that does not fit on a single line of the image"), 
+		CVTextStyle(24, cv::Scalar::all(255), true, 2, cv::Scalar::all(0), true, cv::Scalar::all(0), 0.3), CVRenderText::CENTER_MARGIN, CVRenderText::TOP_MARGIN);
+
 	cv::imwrite("./result.jpg", img);
 
 	return 0;